@@ -0,0 +1,562 @@
+#define _DEFAULT_SOURCE
+
+#include "block_cache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "disassembler.h"
+#include "gameboy.h"
+#include "instructions.h"
+#include "memory.h"
+
+#ifdef BLOCK_CACHE_NATIVE
+#include <sys/mman.h>
+#endif
+
+
+/** Allocates and creates an empty block cache.
+ *
+ * @return A pointer to the BlockCache created.
+*/
+BlockCache* block_cache_create(void) {
+    BlockCache* cache = calloc(1, sizeof(BlockCache));
+
+#ifdef BLOCK_CACHE_NATIVE
+    // Ask for memory just below the emulator's own code, so blocks can call the handlers with
+    // 32 bit relative calls. Blocks fall back to absolute calls if it ends up anywhere else.
+    uintptr_t text = (uintptr_t) &block_cache_execute & ~(uintptr_t) 0xFFFFF;
+    void* hint = text > 2*BLOCK_CODE_SIZE ? (void*) (text - 2*BLOCK_CODE_SIZE) : NULL;
+    void* code = mmap(hint, BLOCK_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    cache->code = code == MAP_FAILED ? NULL : code;
+#endif
+    return cache;
+}
+
+/** Frees all memory used by the block cache.
+ *
+ * @param cache BlockCache to destroy, may be NULL.
+*/
+void block_cache_destroy(BlockCache* cache) {
+#ifdef BLOCK_CACHE_NATIVE
+    if (cache && cache->code) munmap(cache->code, BLOCK_CODE_SIZE);
+#endif
+    free(cache);
+}
+
+/** Invalidates all cached blocks that live in RAM.
+ *
+ * @param cache BlockCache to operate on.
+*/
+void block_cache_invalidate_ram(BlockCache* cache) {
+    for (uint16_t i = 0; i < BLOCK_CACHE_ENTRIES; i++) {
+        if (cache->blocks[i].bank == BLOCK_BANK_RAM) cache->blocks[i].valid = 0;
+    }
+    memset(cache->code_bitmap + (0xC000 >> 3), 0, (0x10000 - 0xC000) >> 3);
+    cache->generation++;
+}
+
+
+/** Finds the memory region containing an address that code can be cached from.
+ *
+ * @param gb Gameboy to operate on.
+ * @param address Address of the code.
+ * @param bank Set to the bank the code is in.
+ * @param region_end Set to the first address after the region.
+ * @return 1 if code at the address can be cached, 0 otherwise.
+*/
+static uint8_t block_cache_region(Gameboy* gb, uint16_t address, uint16_t* bank, uint32_t* region_end) {
+    if (address < 0x4000) {
+        // Code under the bootstrap ROM is only cached once it has been unmapped.
+        if (!gb->memory[0xFF50] && address < 0x100) return 0;
+        *bank = 0;
+        *region_end = 0x4000;
+    } else if (address < 0x8000) {
+        *bank = gb->current_cartridge_bank;
+        *region_end = 0x8000;
+    } else if (address >= 0xC000 && address < 0xE000) {
+        *bank = BLOCK_BANK_RAM;
+        *region_end = 0xE000;
+    } else if (address >= 0xFF80 && address < 0xFFFF) {
+        *bank = BLOCK_BANK_RAM;
+        *region_end = 0xFFFF;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/** Checks whether an instruction ends a basic block.
+ *
+ * @param gb Gameboy to operate on.
+ * @param address Address of the instruction.
+ * @param opcode Opcode of the instruction.
+ * @return 1 if the block should end after the instruction, 0 otherwise.
+*/
+static uint8_t block_cache_ends_block(Gameboy* gb, uint16_t address, uint8_t opcode) {
+    switch (opcode) {
+        case JP_a16: case JP_NZ_a16: case JP_Z_a16: case JP_NC_a16: case JP_C_a16: case JP_HL:
+        case JR_r8: case JR_NZ_r8: case JR_Z_r8: case JR_NC_r8: case JR_C_r8:
+        case CALL_a16: case CALL_NZ_a16: case CALL_Z_a16: case CALL_NC_a16: case CALL_C_a16:
+        case RET: case RET_NZ: case RET_Z: case RET_NC: case RET_C: case RETI:
+        case RST_00H: case RST_08H: case RST_10H: case RST_18H:
+        case RST_20H: case RST_28H: case RST_30H: case RST_38H:
+        case HALT: case STOP:
+            return 1;
+        case LD_a16_A:
+            // Writes to the MBC registers may switch banks.
+            return memory_get16(gb, address+1) < 0x8000;
+        default:
+            return 0;
+    }
+}
+
+#ifdef BLOCK_CACHE_NATIVE
+// Native code of a block starts with the code that leaves it, followed by the entry point.
+// While it runs rbx holds the Gameboy, r12 its cpu, r13d the buttons, r14 the block cache and
+// r15d the generation of the cache the block was entered in.
+
+// Appends the bytes given to the machine code being written.
+#define BLOCK_EMIT(emitter, ...) \
+    block_emit_bytes(emitter, (const uint8_t[]) {__VA_ARGS__}, sizeof((const uint8_t[]) {__VA_ARGS__}))
+
+/** Machine code being written for a block. */
+typedef struct block_emitter_t {
+    uint8_t* code;
+    uint32_t size;
+} BlockEmitter;
+
+// Offset in the CPU of the registers in the order of their 3 bit operand codes, (HL) is 0xFF.
+static const uint8_t block_register_offsets[8] = {
+    offsetof(CPU, B), offsetof(CPU, C), offsetof(CPU, D), offsetof(CPU, E),
+    offsetof(CPU, H), offsetof(CPU, L), 0xFF, offsetof(CPU, A)
+};
+
+// Offset in the CPU of the register pairs in the order of their 2 bit operand codes.
+static const uint8_t block_pair_offsets[4] = {
+    offsetof(CPU, BC), offsetof(CPU, DE), offsetof(CPU, HL), offsetof(CPU, SP)
+};
+
+static void block_emit_bytes(BlockEmitter* emitter, const uint8_t* bytes, uint32_t count) {
+    memcpy(emitter->code + emitter->size, bytes, count);
+    emitter->size += count;
+}
+
+static void block_emit16(BlockEmitter* emitter, uint16_t value) {
+    BLOCK_EMIT(emitter, value & 0xFF, value >> 8);
+}
+
+static void block_emit32(BlockEmitter* emitter, uint32_t value) {
+    BLOCK_EMIT(emitter, value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24);
+}
+
+/** Writes a call of a function taking the Gameboy.
+ *
+ * @param emitter Machine code being written.
+ * @param function Function to call.
+*/
+static void block_emit_call(BlockEmitter* emitter, void* function) {
+    BLOCK_EMIT(emitter, 0x48, 0x89, 0xDF);              // mov rdi, rbx
+    intptr_t offset = (intptr_t) function - (intptr_t) (emitter->code + emitter->size + 5);
+    if (offset == (int32_t) offset) {
+        BLOCK_EMIT(emitter, 0xE8);                       // call rel32
+        block_emit32(emitter, (uint32_t) offset);
+    } else {
+        BLOCK_EMIT(emitter, 0x48, 0xB8);                 // mov rax, imm64
+        block_emit32(emitter, (uint32_t) (uintptr_t) function);
+        block_emit32(emitter, (uint32_t) ((uintptr_t) function >> 32));
+        BLOCK_EMIT(emitter, 0xFF, 0xD0);                 // call rax
+    }
+}
+
+/** Writes a jump to the code that leaves the block, at the start of the code.
+ *
+ * @param emitter Machine code being written.
+ * @param condition Condition code of a jcc, or 0 to always jump.
+*/
+static void block_emit_exit(BlockEmitter* emitter, uint8_t condition) {
+    if (condition) {
+        BLOCK_EMIT(emitter, 0x0F, 0x80 | condition);
+    } else {
+        BLOCK_EMIT(emitter, 0xE9);
+    }
+    block_emit32(emitter, (uint32_t) -(int32_t) (emitter->size + 4));
+}
+
+/** Writes a short forward jump to be patched by block_emit_label.
+ *
+ * @param emitter Machine code being written.
+ * @param opcode Opcode of the jump.
+ * @return Position of the jump's offset.
+*/
+static uint32_t block_emit_jump8(BlockEmitter* emitter, uint8_t opcode) {
+    BLOCK_EMIT(emitter, opcode, 0x00);
+    return emitter->size - 1;
+}
+
+/** Points a jump written by block_emit_jump8 at the end of the code.
+ *
+ * @param emitter Machine code being written.
+ * @param jump Position of the jump's offset.
+*/
+static void block_emit_label(BlockEmitter* emitter, uint32_t jump) {
+    emitter->code[jump] = emitter->size - (jump + 1);
+}
+
+/** Writes the inlined equivalent of gameboy_update_buttons.
+ *
+ * @param emitter Machine code being written.
+*/
+static void block_emit_buttons(BlockEmitter* emitter) {
+    BLOCK_EMIT(emitter, 0x48, 0x8B, 0x83);              // mov rax, [rbx+memory]
+    block_emit32(emitter, offsetof(Gameboy, memory));
+
+    // Request the joypad interrupt if any button is pressed.
+    BLOCK_EMIT(emitter, 0x41, 0x80, 0xFD, 0xFF);        // cmp r13b, 0xFF
+    uint32_t released = block_emit_jump8(emitter, 0x74);
+    BLOCK_EMIT(emitter, 0x80, 0x88);                    // or byte [rax+0xFF0F], 0x10
+    block_emit32(emitter, 0xFF0F);
+    BLOCK_EMIT(emitter, 0x10);
+    block_emit_label(emitter, released);
+
+    // Show the selected half of the buttons in P1.
+    BLOCK_EMIT(emitter, 0x0F, 0xB6, 0x88);              // movzx ecx, byte [rax+0xFF00]
+    block_emit32(emitter, 0xFF00);
+    BLOCK_EMIT(emitter, 0xF6, 0xC1, 0x20);              // test cl, 0x20
+    uint32_t directions = block_emit_jump8(emitter, 0x75);
+    BLOCK_EMIT(emitter, 0x44, 0x89, 0xEA);              // mov edx, r13d
+    BLOCK_EMIT(emitter, 0x83, 0xE2, 0x0F);              // and edx, 0x0F
+    uint32_t low = block_emit_jump8(emitter, 0xEB);
+    block_emit_label(emitter, directions);
+    BLOCK_EMIT(emitter, 0xF6, 0xC1, 0x10);              // test cl, 0x10
+    uint32_t unselected = block_emit_jump8(emitter, 0x75);
+    BLOCK_EMIT(emitter, 0x44, 0x89, 0xEA);              // mov edx, r13d
+    BLOCK_EMIT(emitter, 0xC1, 0xEA, 0x04);              // shr edx, 4
+    block_emit_label(emitter, low);
+    BLOCK_EMIT(emitter, 0x81, 0xE1, 0xF0, 0x00, 0x00, 0x00);   // and ecx, 0xF0
+    BLOCK_EMIT(emitter, 0x09, 0xD1);                    // or ecx, edx
+    BLOCK_EMIT(emitter, 0x88, 0x88);                    // mov [rax+0xFF00], cl
+    block_emit32(emitter, 0xFF00);
+    block_emit_label(emitter, unselected);
+}
+
+/** Writes an instruction as native code if it only moves constants and registers.
+ *
+ * @param emitter Machine code being written.
+ * @param opcode Opcode of the instruction.
+ * @param operand Operand bytes of the instruction, little endian.
+ * @param next Address of the next instruction.
+ * @return Number of cpu cycles the instruction takes, or 0 if it has to call its handler.
+*/
+static uint8_t block_emit_inline(BlockEmitter* emitter, uint8_t opcode, uint16_t operand, uint16_t next) {
+    uint8_t dst = block_register_offsets[(opcode >> 3) & 0x7];
+    uint8_t src = block_register_offsets[opcode & 0x7];
+    uint8_t pair = block_pair_offsets[(opcode >> 4) & 0x3];
+    uint16_t pc = next;
+    uint8_t cycles;
+
+    if (opcode >= 0x40 && opcode < 0x80 && dst != 0xFF && src != 0xFF) {
+        // LD r, r
+        BLOCK_EMIT(emitter, 0x41, 0x8A, 0x84, 0x24);    // mov al, [r12+src]
+        block_emit32(emitter, src);
+        BLOCK_EMIT(emitter, 0x41, 0x88, 0x84, 0x24);    // mov [r12+dst], al
+        block_emit32(emitter, dst);
+        cycles = 4;
+    } else if (opcode < 0x40 && (opcode & 0x7) == 0x6 && dst != 0xFF) {
+        // LD r, d8
+        BLOCK_EMIT(emitter, 0x41, 0xC6, 0x84, 0x24);    // mov byte [r12+dst], d8
+        block_emit32(emitter, dst);
+        BLOCK_EMIT(emitter, operand & 0xFF);
+        cycles = 8;
+    } else if (opcode < 0x40 && (opcode & 0xF) == 0x1) {
+        // LD rr, d16
+        BLOCK_EMIT(emitter, 0x66, 0x41, 0xC7, 0x84, 0x24);  // mov word [r12+pair], d16
+        block_emit32(emitter, pair);
+        block_emit16(emitter, operand);
+        cycles = 12;
+    } else if (opcode < 0x40 && ((opcode & 0xF) == 0x3 || (opcode & 0xF) == 0xB)) {
+        // INC rr and DEC rr
+        BLOCK_EMIT(emitter, 0x66, 0x41, 0xFF, (opcode & 0x8) ? 0x8C : 0x84, 0x24);  // inc/dec word [r12+pair]
+        block_emit32(emitter, pair);
+        cycles = 8;
+    } else if (opcode == NOP) {
+        cycles = 4;
+    } else if (opcode == DI || opcode == EI) {
+        BLOCK_EMIT(emitter, 0xC6, 0x83);                // mov byte [rbx+int_master_enable], imm8
+        block_emit32(emitter, offsetof(Gameboy, int_master_enable));
+        BLOCK_EMIT(emitter, opcode == EI);
+        cycles = 4;
+    } else if (opcode == JP_a16) {
+        pc = operand;
+        cycles = 12;
+    } else if (opcode == JR_r8) {
+        pc = next + (int8_t) operand;
+        cycles = 8;
+    } else {
+        return 0;
+    }
+
+    BLOCK_EMIT(emitter, 0x66, 0x41, 0xC7, 0x84, 0x24);  // mov word [r12+PC], pc
+    block_emit32(emitter, offsetof(CPU, PC));
+    block_emit16(emitter, pc);
+    return cycles;
+}
+
+/** Compiles a decoded block to native code, which does what block_cache_execute does for it.
+ *
+ * @param gb Gameboy to operate on.
+ * @param block Block to compile, its instructions must still be in memory.
+ * @param code Where to write the native code, at least BLOCK_CODE_MAX bytes.
+ * @return Number of bytes of native code written.
+*/
+static uint32_t block_cache_compile(Gameboy* gb, Block* block, uint8_t* code) {
+    BlockEmitter emitter = {code, 0};
+    BlockEmitter* e = &emitter;
+
+    BLOCK_EMIT(e, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);  // pop r15 .. rbx, ret
+    uint32_t entry = e->size;
+    BLOCK_EMIT(e, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57);  // push rbx .. r15
+    BLOCK_EMIT(e, 0x48, 0x89, 0xFB);                    // mov rbx, rdi
+    BLOCK_EMIT(e, 0x41, 0x89, 0xF5);                    // mov r13d, esi
+    BLOCK_EMIT(e, 0x4C, 0x8B, 0xA3);                    // mov r12, [rbx+cpu]
+    block_emit32(e, offsetof(Gameboy, cpu));
+    BLOCK_EMIT(e, 0x4C, 0x8B, 0xB3);                    // mov r14, [rbx+block_cache]
+    block_emit32(e, offsetof(Gameboy, block_cache));
+    BLOCK_EMIT(e, 0x45, 0x8B, 0xBE);                    // mov r15d, [r14+generation]
+    block_emit32(e, offsetof(BlockCache, generation));
+
+    uint8_t called = 1;
+    for (uint8_t i = 0; i < block->length; i++) {
+        uint16_t address = block->addresses[i];
+        uint16_t next = block->addresses[i+1];
+        uint8_t opcode = memory_get8(gb, address);
+        uint16_t operand = next - address > 1 ? memory_get8(gb, address + 1) : 0;
+        if (next - address > 2) operand |= memory_get8(gb, address + 2) << 8;
+
+        // Only handlers and interrupts write P1 or IF, so the buttons are up to date otherwise.
+        if (called) block_emit_buttons(e);
+
+        uint8_t cycles = block_emit_inline(e, opcode, operand, next);
+        called = cycles == 0;
+        if (called) {
+            BLOCK_EMIT(e, 0x66, 0x41, 0xFF, 0x84, 0x24);    // inc word [r12+PC]
+            block_emit32(e, offsetof(CPU, PC));
+            block_emit_call(e, (void*) block->handlers[i]);
+            BLOCK_EMIT(e, 0x0F, 0xB6, 0xC0);            // movzx eax, al
+            BLOCK_EMIT(e, 0x48, 0x01, 0x83);            // add [rbx+cycle_count], rax
+            block_emit32(e, offsetof(Gameboy, cycle_count));
+        } else {
+            BLOCK_EMIT(e, 0x48, 0x83, 0x83);            // add qword [rbx+cycle_count], cycles
+            block_emit32(e, offsetof(Gameboy, cycle_count));
+            BLOCK_EMIT(e, cycles);
+        }
+        BLOCK_EMIT(e, 0x48, 0xFF, 0x83);                // inc qword [rbx+instruction_count]
+        block_emit32(e, offsetof(Gameboy, instruction_count));
+
+        // Run the events that became due.
+        BLOCK_EMIT(e, 0x48, 0x8B, 0x83);                // mov rax, [rbx+cycle_count]
+        block_emit32(e, offsetof(Gameboy, cycle_count));
+        BLOCK_EMIT(e, 0x48, 0x3B, 0x83);                // cmp rax, [rbx+scheduler.next]
+        block_emit32(e, offsetof(Gameboy, scheduler.next));
+        uint32_t no_events = block_emit_jump8(e, 0x72);
+        block_emit_call(e, (void*) gameboy_run_events);
+        block_emit_label(e, no_events);
+
+        // Service an interrupt, which always leaves the block.
+        BLOCK_EMIT(e, 0x80, 0xBB);                      // cmp byte [rbx+int_master_enable], 0
+        block_emit32(e, offsetof(Gameboy, int_master_enable));
+        BLOCK_EMIT(e, 0x00);
+        uint32_t disabled = block_emit_jump8(e, 0x74);
+        BLOCK_EMIT(e, 0x48, 0x8B, 0x83);                // mov rax, [rbx+memory]
+        block_emit32(e, offsetof(Gameboy, memory));
+        BLOCK_EMIT(e, 0x8A, 0x88);                      // mov cl, [rax+0xFFFF]
+        block_emit32(e, 0xFFFF);
+        BLOCK_EMIT(e, 0x22, 0x88);                      // and cl, [rax+0xFF0F]
+        block_emit32(e, 0xFF0F);
+        BLOCK_EMIT(e, 0xF6, 0xC1, 0x1F);                // test cl, 0x1F
+        uint32_t none = block_emit_jump8(e, 0x74);
+        block_emit_call(e, (void*) gameboy_check_interrupts);
+        block_emit_exit(e, 0);
+        block_emit_label(e, disabled);
+        block_emit_label(e, none);
+
+        if (i + 1 == block->length) break;
+
+        // Leave the block at the end of the frame, on a taken branch, or if the code the rest of
+        // the block was compiled from may have changed.
+        BLOCK_EMIT(e, 0x80, 0xBB);                      // cmp byte [rbx+frame_complete], 0
+        block_emit32(e, offsetof(Gameboy, frame_complete));
+        BLOCK_EMIT(e, 0x00);
+        block_emit_exit(e, 0x5);                        // jne
+        if (called) {
+            BLOCK_EMIT(e, 0x66, 0x41, 0x81, 0xBC, 0x24);    // cmp word [r12+PC], next
+            block_emit32(e, offsetof(CPU, PC));
+            block_emit16(e, next);
+            block_emit_exit(e, 0x5);
+            BLOCK_EMIT(e, 0x45, 0x39, 0xBE);            // cmp [r14+generation], r15d
+            block_emit32(e, offsetof(BlockCache, generation));
+            block_emit_exit(e, 0x5);
+            if (block->bank != BLOCK_BANK_RAM && block->addresses[0] >= 0x4000) {
+                BLOCK_EMIT(e, 0x66, 0x81, 0xBB);        // cmp word [rbx+current_cartridge_bank], bank
+                block_emit32(e, offsetof(Gameboy, current_cartridge_bank));
+                block_emit16(e, block->bank);
+                block_emit_exit(e, 0x5);
+            }
+        }
+    }
+    block_emit_exit(e, 0);
+
+    block->code = (BlockCode) (void*) (code + entry);
+    return e->size;
+}
+#endif
+
+/** Decodes the basic block starting at an address into a cache entry.
+ *
+ * @param gb Gameboy to operate on.
+ * @param block Cache entry to fill.
+ * @param start Address of the first instruction.
+ * @param bank Bank the code is in.
+ * @param region_end First address after the region the code is in.
+*/
+static void block_cache_translate(Gameboy* gb, Block* block, uint16_t start, uint16_t bank,
+                                  uint32_t region_end) {
+    uint32_t address = start;
+    uint8_t length = 0;
+
+    while (length < BLOCK_MAX_INSTRUCTIONS) {
+        uint8_t opcode = memory_get8(gb, address);
+        uint8_t size = instruction_lengths[opcode];
+        if (size == 0 || address + size > region_end) break;
+
+        block->addresses[length] = address;
+        block->handlers[length] = instruction_table[opcode];
+        length++;
+        address += size;
+
+        if (block_cache_ends_block(gb, address - size, opcode)) break;
+    }
+
+    block->addresses[length] = address;
+    block->length = length;
+    block->bank = bank;
+    block->valid = length > 0;
+    block->code = NULL;
+
+#ifdef BLOCK_CACHE_NATIVE
+    BlockCache* cache = gb->block_cache;
+    if (block->valid && cache->code) {
+        // Once the executable memory is full every other block is decoded and compiled again.
+        if (cache->code_used + BLOCK_CODE_MAX > BLOCK_CODE_SIZE) {
+            for (uint16_t i = 0; i < BLOCK_CACHE_ENTRIES; i++) {
+                if (&cache->blocks[i] != block) cache->blocks[i].valid = 0;
+            }
+            cache->code_used = 0;
+        }
+        cache->code_used += block_cache_compile(gb, block, cache->code + cache->code_used);
+    }
+#endif
+
+    if (bank == BLOCK_BANK_RAM) {
+        for (uint32_t i = start; i < address; i++) {
+            gb->block_cache->code_bitmap[i >> 3] |= 1 << (i & 0x7);
+        }
+    }
+}
+
+/** Finds the cached block starting at PC, decoding it if it is not in the cache.
+ *
+ * @param gb Gameboy to operate on.
+ * @return The block starting at PC, or NULL if the code at PC can not be cached.
+*/
+static Block* block_cache_lookup(Gameboy* gb) {
+    uint16_t pc = gb->cpu->PC;
+    uint16_t bank;
+    uint32_t region_end;
+    if (!block_cache_region(gb, pc, &bank, &region_end)) return NULL;
+
+    Block* block = &gb->block_cache->blocks[(pc ^ (bank << 5)) & (BLOCK_CACHE_ENTRIES-1)];
+    if (!block->valid || block->addresses[0] != pc || block->bank != bank) {
+        block_cache_translate(gb, block, pc, bank, region_end);
+        if (!block->valid) return NULL;
+    }
+    return block;
+}
+
+
+/** Checks whether a block can run its native code, which does not trace or profile the
+ *  instructions it executes.
+ *
+ * @param gb Gameboy to operate on.
+ * @param block Block to run.
+ * @return 1 if the native code can be run, 0 if the handlers have to be called.
+*/
+static uint8_t block_cache_native(Gameboy* gb, Block* block) {
+    if (!block->code) return 0;
+#ifdef GAMEBOY_TRACE
+    if (gb->trace) return 0;
+#endif
+#ifdef GAMEBOY_PROFILE
+    if (gb->profile) return 0;
+#endif
+    (void) gb;
+    return 1;
+}
+
+
+/** Executes instructions from cached blocks until the current frame is complete.
+ *  Performs the same per instruction event, interrupt and button updates as
+ *  gameboy_single_frame_update.
+ *
+ * @param gb Gameboy to execute the instructions on.
+ * @param buttons Current state of the buttons.
+*/
+void block_cache_execute(Gameboy* gb, uint8_t buttons) {
+    if (!gb->block_cache) gb->block_cache = block_cache_create();
+    BlockCache* cache = gb->block_cache;
+
+    while (!gb->frame_complete) {
+        if (gb->halted) {
+            gameboy_halt_idle(gb, buttons);
+            continue;
+        }
+
+        Block* block = block_cache_lookup(gb);
+
+        // Code that can not be cached is interpreted one instruction at a time.
+        if (!block) {
+            gameboy_update_buttons(gb, buttons);
+            uint8_t instruction = gameboy_fetch_immediate8(gb);
+            gameboy_end_instruction(gb, gameboy_execute_instruction(gb, instruction));
+            continue;
+        }
+
+        if (block_cache_native(gb, block)) {
+            block->code(gb, buttons);
+            continue;
+        }
+
+        uint32_t generation = cache->generation;
+        for (uint8_t i = 0; i < block->length; i++) {
+            gameboy_update_buttons(gb, buttons);
+            GAMEBOY_TRACE_INSTRUCTION(gb, gb->cpu->PC);
+            GAMEBOY_PROFILE_INSTRUCTION(gb, gb->cpu->PC);
+
+            gb->cpu->PC++;  // Opcode has already been decoded.
+            uint8_t events = gameboy_end_instruction(gb, block->handlers[i](gb));
+
+            // Leave the block at the end of the frame, on a taken branch or interrupt, or if
+            // the code the rest of the block was decoded from may have changed.
+            if ((events && gb->frame_complete) || gb->cpu->PC != block->addresses[i+1] ||
+                    cache->generation != generation ||
+                    (block->bank != BLOCK_BANK_RAM && block->addresses[0] >= 0x4000 &&
+                     block->bank != gb->current_cartridge_bank)) {
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef SRC_COMMON_BLOCK_CACHE_H_
+#define SRC_COMMON_BLOCK_CACHE_H_
+
+#include <stdint.h>
+
+#include "gameboy.h"
+#include "instructions.h"
+
+#define BLOCK_CACHE_ENTRIES 1024
+#define BLOCK_MAX_INSTRUCTIONS 16
+
+// Blocks are compiled to native code on x86-64 hosts with mmap. Everywhere else, and while
+// instructions are traced or profiled, block_cache_execute calls the decoded handlers.
+#if defined(__x86_64__) && !defined(_WIN32)
+#define BLOCK_CACHE_NATIVE
+#endif
+#define BLOCK_CODE_SIZE (4 << 20)    // Bytes of native code before the cache is flushed.
+#define BLOCK_CODE_MAX (64 + 256*BLOCK_MAX_INSTRUCTIONS)   // Most bytes of native code a block needs.
+
+// Bank value used for blocks that live in work RAM or high RAM.
+#define BLOCK_BANK_RAM 0xFFFF
+
+/** Native code of a block. Runs the whole block, or until it has to be left early, with the
+ *  same per instruction updates as block_cache_execute.
+ *
+ * @param gb Gameboy to execute the instructions on.
+ * @param buttons Current state of the buttons.
+*/
+typedef void (*BlockCode)(Gameboy* gb, uint32_t buttons);
+
+/** A decoded basic block. Stores the handler and address of each instruction so the
+ *  block can be executed without fetching and decoding the opcodes again.
+*/
+typedef struct block_t {
+    uint16_t bank;
+    uint8_t valid;
+    uint8_t length;
+    uint16_t addresses[BLOCK_MAX_INSTRUCTIONS+1];  // Final entry is the address after the block.
+    InstructionHandler handlers[BLOCK_MAX_INSTRUCTIONS];
+    BlockCode code;                 // NULL if the block was not compiled.
+} Block;
+
+/** Translation cache of decoded blocks keyed by (bank, PC). */
+typedef struct block_cache_t {
+    Block blocks[BLOCK_CACHE_ENTRIES];
+    uint32_t generation;            // Incremented whenever RAM blocks are invalidated.
+    uint8_t code_bitmap[0x10000/8];  // One bit per RAM address that is part of a cached block.
+    uint8_t* code;                  // BLOCK_CODE_SIZE bytes of executable memory, or NULL.
+    uint32_t code_used;
+} BlockCache;
+
+/** Allocates and creates an empty block cache.
+ *
+ * @return A pointer to the BlockCache created.
+*/
+BlockCache* block_cache_create(void);
+
+/** Frees all memory used by the block cache.
+ *
+ * @param cache BlockCache to destroy, may be NULL.
+*/
+void block_cache_destroy(BlockCache* cache);
+
+/** Invalidates all cached blocks that live in RAM.
+ *
+ * @param cache BlockCache to operate on.
+*/
+void block_cache_invalidate_ram(BlockCache* cache);
+
+/** Executes instructions from cached blocks until the current frame is complete.
+ *  Performs the same per instruction event, interrupt and button updates as
+ *  gameboy_single_frame_update.
+ *
+ * @param gb Gameboy to execute the instructions on.
+ * @param buttons Current state of the buttons.
+*/
+void block_cache_execute(Gameboy* gb, uint8_t buttons);
+
+/** Invalidates cached RAM blocks if the address written to holds code of one of them.
+ *
+ * @param gb Gameboy being written to.
+ * @param address Address that was written to.
+*/
+static inline void block_cache_notify_write(Gameboy* gb, uint16_t address) {
+    BlockCache* cache = gb->block_cache;
+    if (address >= 0xC000 && cache && (cache->code_bitmap[address >> 3] & (1 << (address & 0x7)))) {
+        block_cache_invalidate_ram(cache);
+    }
+}
+
+#endif  // SRC_COMMON_BLOCK_CACHE_H_
@@ -5,61 +5,173 @@
 
 #define CPU_FREQUENCY 4194304
 
+// Kind of the last operation that set the flags. The flags in F are only evaluated from the
+// recorded operation when they are read.
+enum CPUFlagOp {
+    FLAGS_NONE,     // F is up to date.
+    FLAGS_ADD,      // 8 bit add, with or without carry.
+    FLAGS_SUB,      // 8 bit subtract or compare, with or without carry.
+    FLAGS_AND,
+    FLAGS_OR,       // Or and xor.
+    FLAGS_INC,      // 8 bit increment, C unchanged.
+    FLAGS_DEC,      // 8 bit decrement, C unchanged.
+    FLAGS_SHIFT,    // Rotates, shifts and swap.
+    FLAGS_ADD16,    // Add to HL, Z unchanged.
+    FLAGS_BIT       // Bit test, C unchanged.
+};
+
+// Declares a register pair that can be accessed as a whole or as its high and low bytes.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CPU_REGISTER_PAIR(pair, hi, lo) union { uint16_t pair; struct { uint8_t hi; uint8_t lo; }; }
+#else
+#define CPU_REGISTER_PAIR(pair, hi, lo) union { uint16_t pair; struct { uint8_t lo; uint8_t hi; }; }
+#endif
+
 typedef struct cpu_t {
-    uint8_t A;
-    uint8_t F;
-    uint8_t B;
-    uint8_t C;
-    uint8_t D;
-    uint8_t E;
-    uint8_t H;
-    uint8_t L;
+    CPU_REGISTER_PAIR(AF, A, F);
+    CPU_REGISTER_PAIR(BC, B, C);
+    CPU_REGISTER_PAIR(DE, D, E);
+    CPU_REGISTER_PAIR(HL, H, L);
     uint16_t SP;
     uint16_t PC;
-} CPU;
-
-uint16_t cpu_get_value_AF(CPU* cpu);
-
-uint16_t cpu_get_value_BC(CPU* cpu);
-
-uint16_t cpu_get_value_DE(CPU* cpu);
-
-uint16_t cpu_get_value_HL(CPU* cpu);
-
-void cpu_set_value_AF(CPU* cpu, uint16_t value);
-
-void cpu_set_value_BC(CPU* cpu, uint16_t value);
-
-void cpu_set_value_DE(CPU* cpu, uint16_t value);
 
-void cpu_set_value_HL(CPU* cpu, uint16_t value);
-
-
-
-void cpu_increment_BC(CPU* cpu);
-void cpu_increment_DE(CPU* cpu);
-void cpu_increment_HL(CPU* cpu);
-
-void cpu_decrement_BC(CPU* cpu);
-void cpu_decrement_DE(CPU* cpu);
-void cpu_decrement_HL(CPU* cpu);
-
-
-
-void cpu_flag_resetZ(CPU* cpu);
-void cpu_flag_resetN(CPU* cpu);
-void cpu_flag_resetH(CPU* cpu);
-void cpu_flag_resetC(CPU* cpu);
-
-void cpu_flag_setZ(CPU* cpu);
-void cpu_flag_setN(CPU* cpu);
-void cpu_flag_setH(CPU* cpu);
-void cpu_flag_setC(CPU* cpu);
+    // Last flag setting operation and its operands.
+    uint8_t flag_op;
+    uint8_t flag_carry;
+    uint16_t flag_a;
+    uint16_t flag_b;
+    uint32_t flag_result;
+} CPU;
 
-uint8_t cpu_flag_getZ(CPU* cpu);
-uint8_t cpu_flag_getN(CPU* cpu);
-uint8_t cpu_flag_getH(CPU* cpu);
-uint8_t cpu_flag_getC(CPU* cpu);
+/** Evaluates the flags of the last recorded operation into F.
+ *
+ * @param cpu CPU to operate on.
+*/
+void cpu_flag_evaluate(CPU* cpu);
+
+static inline uint16_t cpu_get_value_AF(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    return cpu->AF;
+}
+
+static inline uint16_t cpu_get_value_BC(CPU* cpu) {
+    return cpu->BC;
+}
+
+static inline uint16_t cpu_get_value_DE(CPU* cpu) {
+    return cpu->DE;
+}
+
+static inline uint16_t cpu_get_value_HL(CPU* cpu) {
+    return cpu->HL;
+}
+
+static inline void cpu_set_value_AF(CPU* cpu, uint16_t value) {
+    cpu->AF = value & 0xFFF0;  // Can only use top 4 bits of F.
+    cpu->flag_op = FLAGS_NONE;
+}
+
+static inline void cpu_set_value_BC(CPU* cpu, uint16_t value) {
+    cpu->BC = value;
+}
+
+static inline void cpu_set_value_DE(CPU* cpu, uint16_t value) {
+    cpu->DE = value;
+}
+
+static inline void cpu_set_value_HL(CPU* cpu, uint16_t value) {
+    cpu->HL = value;
+}
+
+
+
+static inline void cpu_increment_BC(CPU* cpu) { cpu->BC++; }
+static inline void cpu_increment_DE(CPU* cpu) { cpu->DE++; }
+static inline void cpu_increment_HL(CPU* cpu) { cpu->HL++; }
+
+static inline void cpu_decrement_BC(CPU* cpu) { cpu->BC--; }
+static inline void cpu_decrement_DE(CPU* cpu) { cpu->DE--; }
+static inline void cpu_decrement_HL(CPU* cpu) { cpu->HL--; }
+
+
+
+static inline void cpu_flag_resetZ(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    cpu->F &= ~(1 << 7);
+}
+
+static inline void cpu_flag_resetN(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    cpu->F &= ~(1 << 6);
+}
+
+static inline void cpu_flag_resetH(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    cpu->F &= ~(1 << 5);
+}
+
+static inline void cpu_flag_resetC(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    cpu->F &= ~(1 << 4);
+}
+
+static inline void cpu_flag_setZ(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    cpu->F |= (1 << 7);
+}
+
+static inline void cpu_flag_setN(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    cpu->F |= (1 << 6);
+}
+
+static inline void cpu_flag_setH(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    cpu->F |= (1 << 5);
+}
+
+static inline void cpu_flag_setC(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    cpu->F |= (1 << 4);
+}
+
+static inline uint8_t cpu_flag_getZ(CPU* cpu) {
+    switch (cpu->flag_op) {
+        case FLAGS_NONE:
+        case FLAGS_ADD16:
+            return (cpu->F >> 7) & 0x01;
+        default:
+            return ((uint8_t) cpu->flag_result) == 0;
+    }
+}
+
+static inline uint8_t cpu_flag_getN(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    return (cpu->F >> 6) & 0x01;
+}
+
+static inline uint8_t cpu_flag_getH(CPU* cpu) {
+    if (cpu->flag_op != FLAGS_NONE) cpu_flag_evaluate(cpu);
+    return (cpu->F >> 5) & 0x01;
+}
+
+static inline uint8_t cpu_flag_getC(CPU* cpu) {
+    switch (cpu->flag_op) {
+        case FLAGS_ADD:
+            return (cpu->flag_result >> 8) ? 1 : 0;
+        case FLAGS_SUB:
+            return cpu->flag_a < cpu->flag_b + cpu->flag_carry;
+        case FLAGS_AND:
+        case FLAGS_OR:
+            return 0;
+        case FLAGS_SHIFT:
+            return cpu->flag_carry;
+        case FLAGS_ADD16:
+            return (cpu->flag_result >> 16) ? 1 : 0;
+        default:
+            return (cpu->F >> 4) & 0x01;
+    }
+}
 
 
 
@@ -0,0 +1,82 @@
+#include "disassembler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "instructions.h"
+
+
+#define NAME_ENTRY(opcode, handler, name) [opcode] = name,
+
+const char* const instruction_names[256] = {
+    INSTRUCTION_LIST(NAME_ENTRY)
+    INVALID_INSTRUCTION_LIST(NAME_ENTRY)
+};
+
+const char* const cb_instruction_names[256] = {
+    CB_INSTRUCTION_LIST(NAME_ENTRY)
+};
+
+// Length in bytes of each instruction including its operands. Invalid opcodes have length 0.
+const uint8_t instruction_lengths[256] = {
+    1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,  // 0x00
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  // 0x10
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  // 0x20
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  // 0x30
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x40
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x50
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x60
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x70
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x80
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x90
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0xA0
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0xB0
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,  // 0xC0
+    1, 1, 3, 0, 3, 1, 2, 1, 1, 1, 3, 0, 3, 0, 2, 1,  // 0xD0
+    2, 1, 1, 0, 0, 1, 2, 1, 2, 1, 3, 0, 0, 0, 2, 1,  // 0xE0
+    2, 1, 1, 1, 0, 1, 2, 1, 2, 1, 3, 1, 0, 0, 2, 1,  // 0xF0
+};
+
+
+uint8_t disassemble_instruction(uint16_t pc, const uint8_t* bytes, char* out, size_t size) {
+    uint8_t length = instruction_lengths[bytes[0]];
+    if (bytes[0] == 0xCB) {
+        snprintf(out, size, "%s", cb_instruction_names[bytes[1]]);
+        return length;
+    }
+
+    const char* name = instruction_names[bytes[0]];
+    uint8_t operand8 = bytes[1];
+    uint16_t operand16 = bytes[1] | (bytes[2] << 8);
+    size_t used = 0;
+    while (*name && used + 8 < size) {
+        // Operands the length of the instruction says it does not have are never read.
+        if ((!strncmp(name, "d16", 3) || !strncmp(name, "a16", 3)) && length == 3) {
+            used += snprintf(out + used, size - used, "$%.4X", operand16);
+            name += 3;
+        } else if ((!strncmp(name, "d8", 2) || !strncmp(name, "a8", 2)) && length == 2) {
+            used += snprintf(out + used, size - used, "$%.2X", operand8);
+            name += 2;
+        } else if (!strncmp(name, "r8", 2) && length == 2) {
+            int8_t offset = (int8_t) operand8;
+            if (bytes[0] == JR_r8 || bytes[0] == JR_NZ_r8 || bytes[0] == JR_Z_r8 ||
+                    bytes[0] == JR_NC_r8 || bytes[0] == JR_C_r8) {
+                used += snprintf(out + used, size - used, "$%.4X", (uint16_t) (pc + 2 + offset));
+            } else if (used && out[used-1] == '+') {
+                // SP+r8
+                if (offset < 0) out[used-1] = '-';
+                used += snprintf(out + used, size - used, "$%.2X", offset < 0 ? -offset : offset);
+            } else {
+                used += snprintf(out + used, size - used, "%s$%.2X", offset < 0 ? "-" : "",
+                                 offset < 0 ? -offset : offset);
+            }
+            name += 2;
+        } else {
+            out[used++] = *name++;
+        }
+    }
+    out[used] = '\0';
+    return length;
+}
@@ -0,0 +1,27 @@
+#ifndef SRC_COMMON_DISASSEMBLER_H_
+#define SRC_COMMON_DISASSEMBLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Mnemonics indexed by opcode. Operands are written d8, d16, a8, a16 and r8, the signed offset
+// of JR, ADD SP and LD HL,SP+r8.
+extern const char* const instruction_names[256];
+extern const char* const cb_instruction_names[256];
+
+// Length in bytes of each instruction including its operands, indexed by opcode.
+extern const uint8_t instruction_lengths[256];
+
+/** Writes the mnemonic of an instruction with its operands filled in. Relative jumps are
+ *  written with the address they jump to.
+ *
+ * @param pc Address of the instruction.
+ * @param bytes The opcode followed by the next 2 bytes in memory, which are only read as far as
+ *              the instruction's length.
+ * @param out Buffer to write the mnemonic to.
+ * @param size Size of the buffer.
+ * @return Length of the instruction in bytes, or 0 if the opcode is not valid.
+*/
+uint8_t disassemble_instruction(uint16_t pc, const uint8_t* bytes, char* out, size_t size);
+
+#endif  // SRC_COMMON_DISASSEMBLER_H_
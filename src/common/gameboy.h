@@ -1,82 +1,357 @@
-#ifndef SRC_GAMEBOY_H_
-#define SRC_GAMEBOY_H_
-
-#include <stdint.h>
-#include <stdio.h>
-#include "cpu.h"
-#include "mbc_struct.h"
-
-/** Struct that stores the state of the gameboy. */
-typedef struct gameboy_t {
-    CPU* cpu;
-    uint8_t* memory;
-    uint8_t* ram_banks;
-    uint8_t* bootstrap_rom;
-    uint8_t* cartridge_rom;
-    uint8_t current_cartridge_bank;
-    uint8_t current_ram_bank;
-
-    enum MBCType mbc_type;
-    uint8_t ram_bank_writable;
-    uint8_t doing_rom_banking;
-
-    uint8_t int_master_enable;
-
-    uint32_t timer_counter;
-    uint32_t divider_counter;
-} Gameboy;
-
-/** Gets the next instruction pointed to by PC.
- *
- * @param gb Gameboy to operate on.
- * @return op code of the instruction.
-*/
-uint8_t gameboy_execute_instruction(Gameboy* gb, uint8_t instruction);
-
-/** Executes a instruction with CB prefix.
- *  @param gb Gameboy to execute the instruction on.
- *  @param base The 'base' of the instruction (byte after CB prefix).
- *  
- * @return The number of cpu cycles the instruction took to execute.
-*/
-uint8_t gameboy_execute_cb_prefix_instruction(Gameboy* gb, uint8_t base);
-
-/** Allocates and creates a new Gameboy struct.
- *  
- * @return A pointer to the Gameboy struct created.
-*/
-Gameboy* gameboy_create(void);
-
-/** Frees all memory used by the Gameboy.
- *  
- * @param gb Gameboy to destroy.
- * @return A pointer to the Gameboy struct created.
-*/
-void gameboy_destroy(Gameboy* gb);
-
-/** Loads the bootstrap from specified file into the gameboy emulator's bootstrap ROM memory.
- * 
- * @param gb Gameboy to operate on.
- * @param fp Pointer to the FILE to load the bootstrap from.
-*/
-void gameboy_load_bootstrap(Gameboy* gb, FILE* fp);
-
-/** Loads a ROM from the specified file into the gameboy emulator's cartridge ROM memory.
- *
- * @param gb Gameboy to operate on.
- * @param fp Pointer to the File to load the cartridge ROM from.
-*/
-void gameboy_load_rom(Gameboy* gb, FILE* fp);
-
-/** Enter an infinte loop that reads and executes instructions from the ROM.
- *  Should only be used for testing, does not handle timers, interrupts or display.
- *
- *  @param gb The Gameboy to operate on.
-*/
-void gameboy_execution_loop(Gameboy* gb);
-void gameboy_update_buttons(Gameboy* gb, uint8_t buttons);
-void gameboy_update(Gameboy* gb);
-void gameboy_single_frame_update(Gameboy* gb, uint8_t buttons, uint8_t* frame_buffer);
-
-
-#endif  // SRC_GAMEBOY_H_
+#ifndef SRC_GAMEBOY_H_
+#define SRC_GAMEBOY_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "mbc_struct.h"
+#include "scheduler.h"
+#include "screen.h"
+
+// Pages of memory and ram_banks in the largest state arena, with 16 RAM banks.
+#define GAMEBOY_ARENA_PAGES_MAX 0x300
+
+// Value of halted after HALT ran with interrupts disabled and an enabled interrupt pending.
+#define GAMEBOY_HALT_BUG 2
+
+/** State arena frozen by gameboy_fork. Forked Gameboys read the pages they have not written
+ *  from it, it is freed once the last of them is destroyed.
+*/
+typedef struct shared_state_t {
+    uint8_t* arena;
+    atomic_uint references;
+} SharedState;
+
+/** Struct that stores the state of the gameboy. */
+typedef struct gameboy_t {
+    // Allocated together in one state arena, in the order memory, ram_banks, bootstrap_rom, cpu.
+    CPU* cpu;
+    uint8_t* memory;
+    uint8_t* ram_banks;
+    uint8_t* bootstrap_rom;
+    uint8_t* state;             // Arena from memory + 0x8000 on, the part that changes.
+    uint32_t state_size;
+    uint8_t* cartridge_rom;
+    struct rom_map_t* rom_map;   // Mapping cartridge_rom points into, NULL if no ROM is loaded.
+
+    // Set once the Gameboy has been forked. Pages of work RAM, OAM and cartridge RAM are read
+    // from the shared arena until they are first written, see gameboy_fork.
+    SharedState* shared_state;
+    uint8_t* shared_pages;      // One flag per 256 byte page of memory and ram_banks.
+    uint16_t current_cartridge_bank;
+    uint8_t current_ram_bank;
+    uint16_t rom_bank_count;
+    uint8_t ram_bank_count;
+
+    enum MBCType mbc_type;
+    uint8_t ram_bank_writable;
+    uint8_t doing_rom_banking;
+    RTC rtc;
+    uint8_t rtc_page[0x100];    // Mapped over cartridge RAM while an RTC register is selected.
+
+    uint8_t int_master_enable;
+    uint8_t halted;             // Set by HALT until an enabled interrupt is requested, or to
+                                // GAMEBOY_HALT_BUG if the next opcode is to be read twice.
+
+    // Totals since the Gameboy was created.
+    uint64_t cycle_count;
+    uint64_t instruction_count;
+
+    // DIV and TIMA are derived from cycle_count when they are read, see gameboy_sync_timer.
+    uint64_t divider_base;      // cycle_count when DIV was last reset.
+    uint64_t timer_synced;      // cycle_count TIMA was last brought up to date at.
+
+    Scheduler scheduler;
+
+    // State of the frame being run by gameboy_single_frame_update.
+    uint8_t* frame_buffer;      // NULL when the frame is not drawn.
+    uint8_t frame_lines;        // Scanlines run so far.
+    uint8_t frame_complete;
+
+    struct block_cache_t* block_cache;
+    struct tile_cache_t* tile_cache;
+    struct frame_output_t* frame_output;   // Pixel format frames are written in.
+    struct trace_buffer_t* trace;   // Records executed instructions when not NULL.
+    struct profile_t* profile;      // Counts executed instructions when not NULL.
+
+    // Host pointers to the start of each 256 byte page of the address space, rebuilt by
+    // memory_map_update. Pages without a write pointer are handled by memory_set8_slow.
+    uint8_t* read_map[0x100];
+    uint8_t* write_map[0x100];
+    uint8_t* shared_write_map[0x100];  // Write pointer of pages still read from shared_state.
+
+    // Incremental state hash, see gameboy_state_hash. Only pages written since the last hash
+    // are hashed again. The first write to a page after it was hashed finds no write pointer
+    // and marks the page in memory_set8_slow.
+    uint8_t* clean_write_map[0x100];   // Write pointer of pages not written since the last hash.
+    uint8_t dirty_pages[GAMEBOY_ARENA_PAGES_MAX];  // Pages of the state arena to hash again.
+    uint64_t page_hashes[GAMEBOY_ARENA_PAGES_MAX];
+    uint64_t memory_hash;       // XOR of page_hashes.
+} Gameboy;
+
+/** Gets the next 8 bit immediate value pointed to by PC.
+ *
+ * @param gb Gameboy to operate on.
+ * @return 8 bit value of the immediate value.
+*/
+static inline uint8_t gameboy_fetch_immediate8(Gameboy* gb) {
+    uint16_t address = gb->cpu->PC++;
+    return gb->read_map[address >> 8][address & 0xFF];
+}
+
+/** Gets the next 16 bit immediate value pointed to by PC.
+ *
+ * @param gb Gameboy to operate on.
+ * @return 16 bit value of the immediate value.
+*/
+static inline uint16_t gameboy_fetch_immediate16(Gameboy* gb) {
+    uint8_t low = gameboy_fetch_immediate8(gb);
+    return (gameboy_fetch_immediate8(gb) << 8) | low;
+}
+
+/** Pushes a 16 bit value on to the gameboy's stack.
+ *
+ * @param gb Gameboy to operate on.
+ * @param value 16 bit value to push onto the stack.
+*/
+void gameboy_push16(Gameboy* gb, uint16_t value);
+
+/** Pops a 16 bit value off the gameboy's stack.
+ *
+ * @param gb Gameboy to operate on.
+ * @return 16 bit value popped off the stack.
+*/
+uint16_t gameboy_pop16(Gameboy* gb);
+
+/** Checks whether any interrupts have occured. If inerrupts are enabled, the interrupt is serviced.
+ *
+ * @param gb Gameboy to operate on.
+*/
+void gameboy_check_interrupts(Gameboy* gb);
+
+/** Runs every scheduled event that is due.
+ *
+ * @param gb Gameboy to operate on.
+*/
+void gameboy_run_events(Gameboy* gb);
+
+/** Brings DIV and TIMA in memory up to date with cycle_count, requesting the timer interrupt
+ *  if TIMA overflowed.
+ *
+ * @param gb Gameboy to operate on.
+*/
+void gameboy_sync_timer(Gameboy* gb);
+
+/** Writes to one of the timer registers DIV, TIMA, TMA or TAC.
+ *
+ * @param gb Gameboy to operate on.
+ * @param address Address of the register.
+ * @param value Value written.
+*/
+void gameboy_write_timer(Gameboy* gb, uint16_t address, uint8_t value);
+
+/** Records the start of the instruction at an address in the Gameboy's profile.
+ *
+ * @param gb Gameboy to operate on.
+ * @param pc Address of the instruction about to be executed.
+*/
+void gameboy_profile_instruction(Gameboy* gb, uint16_t pc);
+
+/** Records the end of an instruction in the Gameboy's profile.
+ *
+ * @param gb Gameboy to operate on.
+ * @param cycles Number of cpu cycles the instruction took.
+*/
+void gameboy_profile_end_instruction(Gameboy* gb, uint8_t cycles);
+
+// Profiles instructions, interrupts and halted time if profiling is enabled at runtime.
+// Compiled out unless GAMEBOY_PROFILE is defined.
+#ifdef GAMEBOY_PROFILE
+#define GAMEBOY_PROFILE_INSTRUCTION(gb, pc) \
+    do { if ((gb)->profile) gameboy_profile_instruction(gb, pc); } while (0)
+#define GAMEBOY_PROFILE_END_INSTRUCTION(gb, cycles) \
+    do { if ((gb)->profile) gameboy_profile_end_instruction(gb, cycles); } while (0)
+#define GAMEBOY_PROFILE_INTERRUPT(gb, vector) \
+    do { if ((gb)->profile) profile_interrupt((gb)->profile, vector, (gb)->cpu->SP); } while (0)
+#define GAMEBOY_PROFILE_IDLE(gb, cycles) \
+    do { if ((gb)->profile) profile_idle((gb)->profile, cycles); } while (0)
+#else
+#define GAMEBOY_PROFILE_INSTRUCTION(gb, pc) ((void) 0)
+#define GAMEBOY_PROFILE_END_INSTRUCTION(gb, cycles) ((void) 0)
+#define GAMEBOY_PROFILE_INTERRUPT(gb, vector) ((void) 0)
+#define GAMEBOY_PROFILE_IDLE(gb, cycles) ((void) 0)
+#endif
+
+/** Accounts for an executed instruction, runs any events that became due during it, then
+ *  checks for interrupts.
+ *
+ * @param gb Gameboy to operate on.
+ * @param cycles Number of cpu cycles the instruction took.
+ * @return 1 if any events were run, 0 otherwise.
+*/
+static inline uint8_t gameboy_end_instruction(Gameboy* gb, uint8_t cycles) {
+    GAMEBOY_PROFILE_END_INSTRUCTION(gb, cycles);
+    gb->cycle_count += cycles;
+    gb->instruction_count++;
+
+    uint8_t events = gb->cycle_count >= gb->scheduler.next;
+    if (events) gameboy_run_events(gb);
+    gameboy_check_interrupts(gb);
+    return events;
+}
+
+/** Handles a halted Gameboy. If an enabled interrupt has been requested the cpu wakes up,
+ *  otherwise nothing can happen before the next event, so time skips straight to it. After
+ *  the HALT bug the next instruction is executed instead, with its opcode read twice.
+ *
+ * @param gb Gameboy to operate on.
+ * @param buttons Current state of the buttons.
+ * @return 1 if any events were run, 0 otherwise.
+*/
+uint8_t gameboy_halt_idle(Gameboy* gb, uint8_t buttons);
+
+/** Records the instruction at an address in the Gameboy's trace buffer.
+ *
+ * @param gb Gameboy to operate on.
+ * @param pc Address of the instruction about to be executed.
+*/
+void gameboy_trace_instruction(Gameboy* gb, uint16_t pc);
+
+// Traces an instruction if tracing is enabled at runtime. Compiled out unless GAMEBOY_TRACE
+// is defined.
+#ifdef GAMEBOY_TRACE
+#define GAMEBOY_TRACE_INSTRUCTION(gb, pc) \
+    do { if ((gb)->trace) gameboy_trace_instruction(gb, pc); } while (0)
+#else
+#define GAMEBOY_TRACE_INSTRUCTION(gb, pc) ((void) 0)
+#endif
+
+/** Executes a single instruction.
+ *  @param gb Gameboy to execute the instruction on.
+ *  @param instruction The opcode of the instruction to execute.
+ *
+ * @return The number of cpu cycles the instruction took to execute.
+*/
+uint8_t gameboy_execute_instruction(Gameboy* gb, uint8_t instruction);
+
+/** Executes a instruction with CB prefix.
+ *  @param gb Gameboy to execute the instruction on.
+ *  @param base The 'base' of the instruction (byte after CB prefix).
+ *  
+ * @return The number of cpu cycles the instruction took to execute.
+*/
+uint8_t gameboy_execute_cb_prefix_instruction(Gameboy* gb, uint8_t base);
+
+/** Allocates and creates a new Gameboy struct.
+ *  
+ * @return A pointer to the Gameboy struct created.
+*/
+Gameboy* gameboy_create(void);
+
+/** Creates a child Gameboy in the same state as a Gameboy. The child shares the cartridge ROM
+ *  and every page of work RAM and cartridge RAM with its parent until either of them writes
+ *  the page, so forking costs a copy of video RAM, OAM and the I/O registers rather than the
+ *  whole state. Both Gameboys can be forked again and run independently.
+ *
+ * @param gb Gameboy to fork.
+ * @return A pointer to the Gameboy created.
+*/
+Gameboy* gameboy_fork(Gameboy* gb);
+
+/** Gives a page still shared with other forks its own copy, after which it can be written.
+ *
+ * @param gb Gameboy to operate on.
+ * @param page Start of the page in the Gameboy's own state arena.
+*/
+void gameboy_unshare_page(Gameboy* gb, uint8_t* page);
+
+/** Gives every page still shared with other forks its own copy, so the state arena holds the
+ *  whole state.
+ *
+ * @param gb Gameboy to operate on.
+*/
+void gameboy_unshare_state(Gameboy* gb);
+
+/** Marks the whole state arena as needing to be hashed again, e.g. after it was replaced or
+ *  written to directly.
+ *
+ * @param gb Gameboy to operate on.
+*/
+void gameboy_invalidate_state_hash(Gameboy* gb);
+
+/** Copies the state arena, from memory + 0x8000 on, reading pages still shared with other
+ *  forks from the shared arena.
+ *
+ * @param gb Gameboy to operate on.
+ * @param out Buffer of gb->state_size bytes.
+*/
+void gameboy_copy_state(Gameboy* gb, uint8_t* out);
+
+/** Frees all memory used by the Gameboy.
+ *  
+ * @param gb Gameboy to destroy.
+ * @return A pointer to the Gameboy struct created.
+*/
+void gameboy_destroy(Gameboy* gb);
+
+/** Loads the bootstrap from specified file into the gameboy emulator's bootstrap ROM memory.
+ * 
+ * @param gb Gameboy to operate on.
+ * @param fp Pointer to the FILE to load the bootstrap from.
+*/
+void gameboy_load_bootstrap(Gameboy* gb, FILE* fp);
+
+/** Puts the Gameboy in the state the bootstrap ROM leaves it in, so a cartridge can be run
+ *  without a bootstrap ROM.
+ *
+ * @param gb Gameboy to operate on.
+*/
+void gameboy_skip_bootstrap(Gameboy* gb);
+
+/** Loads a ROM from the specified file into the gameboy emulator's cartridge ROM memory.
+ *
+ * @param gb Gameboy to operate on.
+ * @param fp Pointer to the File to load the cartridge ROM from.
+*/
+void gameboy_load_rom(Gameboy* gb, FILE* fp);
+
+/** Maps a ROM file read only and uses the mapping as the cartridge ROM without copying it.
+ *  Gameboys that map the same file share a single mapping.
+ *
+ * @param gb Gameboy to operate on.
+ * @param path Path of the ROM file.
+ * @return 0 on success, 1 if the ROM could not be mapped or is not valid, the Gameboy is then
+ *         left without a ROM.
+*/
+int gameboy_map_rom(Gameboy* gb, const char* path);
+
+/** Sets the pixel format frames are written in. Frame buffers passed to
+ *  gameboy_single_frame_update must hold screen_frame_bytes(format) bytes.
+ *
+ * @param gb Gameboy to operate on.
+ * @param format Pixel format to write.
+ * @param pallet Color of each shade as 0xRRGGBB, or NULL for the default grays.
+*/
+void gameboy_set_frame_format(Gameboy* gb, enum FrameFormat format, const uint32_t* pallet);
+
+/** Enter an infinte loop that reads and executes instructions from the ROM.
+ *  Should only be used for testing, does not handle timers, interrupts or display.
+ *
+ *  @param gb The Gameboy to operate on.
+*/
+void gameboy_execution_loop(Gameboy* gb);
+void gameboy_update_buttons(Gameboy* gb, uint8_t buttons);
+void gameboy_update(Gameboy* gb);
+
+/** Runs the Gameboy for one frame.
+ *
+ * @param gb Gameboy to operate on.
+ * @param buttons State of the buttons.
+ * @param frame_buffer Frame buffer to draw the frame to, or NULL to skip drawing it. Skipped frames
+ *                     still update LY, STAT and raise the LCD interrupts.
+*/
+void gameboy_single_frame_update(Gameboy* gb, uint8_t buttons, uint8_t* frame_buffer);
+
+
+#endif  // SRC_GAMEBOY_H_
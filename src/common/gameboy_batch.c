@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "gameboy_batch.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gameboy.h"
+#include "logging.h"
+#include "screen.h"
+
+
+/** Runs instances from the range of a worker, then steals instances from the other ranges
+ *  until every instance of the step has been run.
+ *
+ * @param batch GameboyBatch to operate on.
+ * @param worker Index of the worker.
+*/
+static void gameboy_batch_run(GameboyBatch* batch, uint32_t worker) {
+    for (uint32_t r = 0; r < batch->thread_count; r++) {
+        BatchRange* range = &batch->ranges[(worker + r) % batch->thread_count];
+
+        uint32_t i;
+        while ((i = atomic_fetch_add_explicit(&range->next, 1, memory_order_relaxed)) < range->end) {
+            Gameboy* gb = batch->gameboys[i];
+            uint8_t* frame = batch->frames + (size_t) i*batch->frame_bytes;
+            // Only the last frame of the step is kept, so the others are not drawn.
+            for (uint32_t f = 1; f < batch->step_frames; f++) {
+                gameboy_single_frame_update(gb, batch->buttons[i], NULL);
+            }
+            if (batch->step_frames) gameboy_single_frame_update(gb, batch->buttons[i], frame);
+        }
+    }
+}
+
+/** Entry point of the worker threads. Waits for a step to start, runs it, then reports back.
+ *
+ * @param arg BatchWorker of the thread.
+ * @return NULL.
+*/
+static void* gameboy_batch_worker(void* arg) {
+    BatchWorker* worker = arg;
+    GameboyBatch* batch = worker->batch;
+    uint32_t generation = 0;
+
+    pthread_mutex_lock(&batch->lock);
+    while (1) {
+        while (batch->generation == generation && !batch->stop) {
+            pthread_cond_wait(&batch->start, &batch->lock);
+        }
+        if (batch->stop) break;
+        generation = batch->generation;
+        pthread_mutex_unlock(&batch->lock);
+
+        gameboy_batch_run(batch, worker->index);
+
+        pthread_mutex_lock(&batch->lock);
+        if (--batch->running == 0) pthread_cond_signal(&batch->done);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return NULL;
+}
+
+
+GameboyBatch* gameboy_batch_create(uint32_t count, const char* rom_path, const char* bootstrap_path,
+                                   uint32_t threads) {
+    FILE* bootstrap_fp = NULL;
+    if (bootstrap_path) bootstrap_fp = fopen(bootstrap_path, "rb");
+    if (bootstrap_path && !bootstrap_fp) {
+        LOG_ERROR("Could not open bootstrap ROM %s", bootstrap_path);
+        return NULL;
+    }
+
+    GameboyBatch* batch = calloc(1, sizeof(GameboyBatch));
+    batch->gameboys = malloc(count*sizeof(Gameboy*));
+    batch->frame_bytes = SCREEN_FRAME_BYTES;
+    batch->frames = calloc(count, batch->frame_bytes);
+    for (uint32_t i = 0; i < count; i++) {
+        Gameboy* gb = gameboy_create();
+        if (gameboy_map_rom(gb, rom_path)) {
+            gameboy_destroy(gb);
+            break;
+        }
+        batch->gameboys[batch->count++] = gb;
+
+        if (bootstrap_fp) {
+            rewind(bootstrap_fp);
+            gameboy_load_bootstrap(gb, bootstrap_fp);
+        } else {
+            gameboy_skip_bootstrap(gb);
+        }
+    }
+    if (bootstrap_fp) fclose(bootstrap_fp);
+
+    if (batch->count < count) {
+        for (uint32_t i = 0; i < batch->count; i++) gameboy_destroy(batch->gameboys[i]);
+        free(batch->gameboys);
+        free(batch->frames);
+        free(batch);
+        return NULL;
+    }
+
+    if (threads == 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > count) threads = count;
+    if (threads == 0) threads = 1;
+    batch->thread_count = threads;
+
+    batch->ranges = aligned_alloc(_Alignof(BatchRange), threads*sizeof(BatchRange));
+    batch->workers = malloc(threads*sizeof(BatchWorker));
+    batch->threads = malloc(threads*sizeof(pthread_t));
+    pthread_mutex_init(&batch->lock, NULL);
+    pthread_cond_init(&batch->start, NULL);
+    pthread_cond_init(&batch->done, NULL);
+
+    for (uint32_t t = 0; t < threads; t++) {
+        atomic_init(&batch->ranges[t].next, 0);
+        batch->ranges[t].end = 0;
+        batch->workers[t].batch = batch;
+        batch->workers[t].index = t;
+    }
+    // Worker 0 is the thread that calls gameboy_batch_step.
+    for (uint32_t t = 1; t < threads; t++) {
+        pthread_create(&batch->threads[t], NULL, gameboy_batch_worker, &batch->workers[t]);
+    }
+    return batch;
+}
+
+void gameboy_batch_destroy(GameboyBatch* batch) {
+    pthread_mutex_lock(&batch->lock);
+    batch->stop = 1;
+    pthread_cond_broadcast(&batch->start);
+    pthread_mutex_unlock(&batch->lock);
+    for (uint32_t t = 1; t < batch->thread_count; t++) {
+        pthread_join(batch->threads[t], NULL);
+    }
+
+    pthread_mutex_destroy(&batch->lock);
+    pthread_cond_destroy(&batch->start);
+    pthread_cond_destroy(&batch->done);
+
+    for (uint32_t i = 0; i < batch->count; i++) {
+        gameboy_destroy(batch->gameboys[i]);
+    }
+    free(batch->gameboys);
+    free(batch->frames);
+    free(batch->ranges);
+    free(batch->workers);
+    free(batch->threads);
+    free(batch);
+}
+
+void gameboy_batch_set_frame_format(GameboyBatch* batch, enum FrameFormat format, const uint32_t* pallet) {
+    for (uint32_t i = 0; i < batch->count; i++) {
+        gameboy_set_frame_format(batch->gameboys[i], format, pallet);
+    }
+
+    batch->frame_bytes = screen_frame_bytes(format);
+    free(batch->frames);
+    batch->frames = calloc(batch->count, batch->frame_bytes);
+}
+
+void gameboy_batch_step(GameboyBatch* batch, const uint8_t* buttons, uint32_t frames) {
+    // Give each worker a contiguous range of instances.
+    for (uint32_t t = 0; t < batch->thread_count; t++) {
+        atomic_store_explicit(&batch->ranges[t].next, (uint64_t) batch->count*t/batch->thread_count,
+                              memory_order_relaxed);
+        batch->ranges[t].end = (uint64_t) batch->count*(t+1)/batch->thread_count;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    batch->buttons = buttons;
+    batch->step_frames = frames;
+    batch->running = batch->thread_count - 1;
+    batch->generation++;
+    pthread_cond_broadcast(&batch->start);
+    pthread_mutex_unlock(&batch->lock);
+
+    gameboy_batch_run(batch, 0);
+
+    pthread_mutex_lock(&batch->lock);
+    while (batch->running) pthread_cond_wait(&batch->done, &batch->lock);
+    pthread_mutex_unlock(&batch->lock);
+}
@@ -0,0 +1,88 @@
+#ifndef SRC_COMMON_GAMEBOY_BATCH_H_
+#define SRC_COMMON_GAMEBOY_BATCH_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "gameboy.h"
+#include "screen.h"
+
+// Batches run on POSIX threads, so they are not part of the Windows build.
+
+/** Range of instances owned by one worker. Idle workers steal instances from the ranges of
+ *  other workers. Aligned to a cache line so workers do not contend on each other's cursor.
+*/
+typedef struct batch_range_t {
+    _Alignas(64) atomic_uint next;
+    uint32_t end;
+} BatchRange;
+
+/** Arguments of a worker thread. */
+typedef struct batch_worker_t {
+    struct gameboy_batch_t* batch;
+    uint32_t index;
+} BatchWorker;
+
+/** A fleet of independent Gameboys that are stepped in lockstep by a pool of worker threads. */
+typedef struct gameboy_batch_t {
+    uint32_t count;
+    Gameboy** gameboys;
+    uint8_t* frames;            // Contiguous [count] frames of frame_bytes each.
+    uint32_t frame_bytes;       // Size of a frame in the batch's pixel format, RGB888 by default.
+
+    // Worker thread pool, the thread calling gameboy_batch_step acts as worker 0.
+    uint32_t thread_count;
+    pthread_t* threads;
+    BatchWorker* workers;
+    BatchRange* ranges;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint32_t generation;        // Incremented each time a step is started.
+    uint32_t running;           // Number of worker threads still running the current step.
+    uint8_t stop;
+
+    // Arguments of the current step.
+    const uint8_t* buttons;
+    uint32_t step_frames;
+} GameboyBatch;
+
+/** Allocates and creates a batch of Gameboys that all run the same ROM. The ROM is mapped
+ *  once and shared by every instance.
+ *
+ * @param count Number of Gameboys in the batch.
+ * @param rom_path Path of the ROM file.
+ * @param bootstrap_path Path of the bootstrap ROM file, or NULL to start after the bootstrap.
+ * @param threads Number of threads to step the batch with, or 0 to use one per online cpu.
+ * @return A pointer to the GameboyBatch created, or NULL if the ROM or bootstrap ROM could not
+ *         be loaded.
+*/
+GameboyBatch* gameboy_batch_create(uint32_t count, const char* rom_path, const char* bootstrap_path,
+                                   uint32_t threads);
+
+/** Stops the worker threads and frees all memory used by the batch and its Gameboys.
+ *
+ * @param batch GameboyBatch to destroy.
+*/
+void gameboy_batch_destroy(GameboyBatch* batch);
+
+/** Sets the pixel format every Gameboy in the batch writes its frames in and resizes the frames
+ *  buffer to match. Must not be called while a step is running.
+ *
+ * @param batch GameboyBatch to operate on.
+ * @param format Pixel format to write.
+ * @param pallet Color of each shade as 0xRRGGBB, or NULL for the default grays.
+*/
+void gameboy_batch_set_frame_format(GameboyBatch* batch, enum FrameFormat format, const uint32_t* pallet);
+
+/** Runs every Gameboy in the batch for a number of frames and waits for all of them to finish.
+ *  Only the last frame is drawn, it is written to frames + i*frame_bytes for Gameboy i.
+ *
+ * @param batch GameboyBatch to operate on.
+ * @param buttons State of the buttons of each Gameboy, count entries.
+ * @param frames Number of frames to run.
+*/
+void gameboy_batch_step(GameboyBatch* batch, const uint8_t* buttons, uint32_t frames);
+
+#endif  // SRC_COMMON_GAMEBOY_BATCH_H_
@@ -0,0 +1,235 @@
+#include "gameboy_movie.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+#include "gameboy_state.h"
+
+/** Cursor into a movie file read into memory. */
+typedef struct movie_reader_t {
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    uint8_t failed;             // Set once a read went past the end of the data.
+} MovieReader;
+
+
+/** Writes an unsigned value of up to 8 bytes to a file, least significant byte first.
+ *
+ * @param fp File to write to.
+ * @param value Value to write.
+ * @param size Size of the value in bytes.
+*/
+static void movie_write_value(FILE* fp, uint64_t value, uint8_t size) {
+    for (uint8_t i = 0; i < size; i++) fputc((value >> (i*8)) & 0xFF, fp);
+}
+
+/** Writes a length to a file, 7 bits per byte with the top bit set on all but the last.
+ *
+ * @param fp File to write to.
+ * @param value Length to write.
+*/
+static void movie_write_length(FILE* fp, uint32_t value) {
+    while (value >= 0x80) {
+        fputc((value & 0x7F) | 0x80, fp);
+        value >>= 7;
+    }
+    fputc(value, fp);
+}
+
+/** Reads an unsigned value written by movie_write_value.
+ *
+ * @param reader Reader to operate on.
+ * @param size Size of the value in bytes.
+ * @return The value, or 0 if the data ended.
+*/
+static uint64_t movie_read_value(MovieReader* reader, uint8_t size) {
+    if (reader->size - reader->offset < size) {
+        reader->failed = 1;
+        return 0;
+    }
+
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < size; i++) {
+        value |= (uint64_t) reader->data[reader->offset++] << (i*8);
+    }
+    return value;
+}
+
+/** Reads a length written by movie_write_length.
+ *
+ * @param reader Reader to operate on.
+ * @return The length, or 0 if the data ended or the length is too long.
+*/
+static uint32_t movie_read_length(MovieReader* reader) {
+    uint32_t value = 0;
+    for (uint8_t shift = 0; shift < 32; shift += 7) {
+        uint8_t byte = movie_read_value(reader, 1);
+        value |= (uint32_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    reader->failed = 1;
+    return 0;
+}
+
+/** Gets the number of checkpoints in a movie.
+ *
+ * @param movie GameboyMovie to operate on.
+ * @return Number of checkpoints.
+*/
+static uint32_t movie_checkpoint_count(GameboyMovie* movie) {
+    return movie->checkpoint_interval ? movie->frame_count / movie->checkpoint_interval : 0;
+}
+
+/** Makes room for a frame to be added to a movie.
+ *
+ * @param movie GameboyMovie to operate on.
+ * @param frame_count Number of frames the movie needs to hold.
+*/
+static void movie_reserve(GameboyMovie* movie, uint32_t frame_count) {
+    if (frame_count <= movie->frame_capacity) return;
+
+    movie->frame_capacity = frame_count > 2*movie->frame_capacity ? frame_count : 2*movie->frame_capacity;
+    movie->buttons = realloc(movie->buttons, movie->frame_capacity);
+    if (movie->checkpoint_interval) {
+        uint32_t checkpoints = movie->frame_capacity / movie->checkpoint_interval;
+        movie->checkpoints = realloc(movie->checkpoints, (checkpoints ? checkpoints : 1)*sizeof(uint64_t));
+    }
+}
+
+
+GameboyMovie* gameboy_movie_create(Gameboy* gb, uint8_t power_on, uint32_t checkpoint_interval) {
+    GameboyMovie* movie = calloc(1, sizeof(GameboyMovie));
+    movie->rom_hash = gameboy_rom_hash(gb);
+    movie->checkpoint_interval = checkpoint_interval;
+
+    if (!power_on) {
+        movie->start_state_size = gameboy_state_size(gb);
+        movie->start_state = malloc(movie->start_state_size);
+        gameboy_save_state(gb, movie->start_state);
+    }
+    return movie;
+}
+
+void gameboy_movie_destroy(GameboyMovie* movie) {
+    free(movie->start_state);
+    free(movie->buttons);
+    free(movie->checkpoints);
+    free(movie);
+}
+
+void gameboy_movie_record_frame(GameboyMovie* movie, Gameboy* gb, uint8_t buttons,
+                                uint8_t* frame_buffer) {
+    gameboy_single_frame_update(gb, buttons, frame_buffer);
+
+    movie_reserve(movie, movie->frame_count + 1);
+    movie->buttons[movie->frame_count++] = buttons;
+    if (movie->checkpoint_interval && movie->frame_count % movie->checkpoint_interval == 0) {
+        movie->checkpoints[movie->frame_count / movie->checkpoint_interval - 1] = gameboy_state_hash(gb);
+    }
+}
+
+int gameboy_movie_save(GameboyMovie* movie, const char* path) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) return 1;
+
+    movie_write_value(fp, GAMEBOY_MOVIE_MAGIC, 4);
+    movie_write_value(fp, GAMEBOY_MOVIE_VERSION, 2);
+    movie_write_value(fp, movie->rom_hash, 8);
+    movie_write_value(fp, movie->checkpoint_interval, 4);
+    movie_write_value(fp, movie->frame_count, 4);
+    movie_write_value(fp, movie->start_state_size, 4);
+    if (movie->start_state) fwrite(movie->start_state, 1, movie->start_state_size, fp);
+
+    // Buttons rarely change between frames, so they are stored as runs.
+    uint32_t frame = 0;
+    while (frame < movie->frame_count) {
+        uint32_t run = 1;
+        while (frame + run < movie->frame_count && movie->buttons[frame + run] == movie->buttons[frame]) run++;
+        movie_write_length(fp, run);
+        fputc(movie->buttons[frame], fp);
+        frame += run;
+    }
+
+    for (uint32_t i = 0; i < movie_checkpoint_count(movie); i++) {
+        movie_write_value(fp, movie->checkpoints[i], 8);
+    }
+
+    int failed = ferror(fp);
+    if (fclose(fp)) failed = 1;
+    return failed ? 1 : 0;
+}
+
+GameboyMovie* gameboy_movie_load(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    MovieReader reader = {data, fread(data, 1, size > 0 ? size : 0, fp), 0, 0};
+    fclose(fp);
+
+    GameboyMovie* movie = calloc(1, sizeof(GameboyMovie));
+    uint32_t magic = movie_read_value(&reader, 4);
+    uint16_t version = movie_read_value(&reader, 2);
+    movie->rom_hash = movie_read_value(&reader, 8);
+    movie->checkpoint_interval = movie_read_value(&reader, 4);
+    uint32_t frame_count = movie_read_value(&reader, 4);
+    movie->start_state_size = movie_read_value(&reader, 4);
+
+    if (reader.failed || magic != GAMEBOY_MOVIE_MAGIC || version != GAMEBOY_MOVIE_VERSION ||
+            movie->start_state_size > reader.size - reader.offset) {
+        reader.failed = 1;
+    } else if (movie->start_state_size) {
+        movie->start_state = malloc(movie->start_state_size);
+        memcpy(movie->start_state, reader.data + reader.offset, movie->start_state_size);
+        reader.offset += movie->start_state_size;
+    }
+
+    if (!reader.failed) movie_reserve(movie, frame_count);
+    while (!reader.failed && movie->frame_count < frame_count) {
+        uint32_t run = movie_read_length(&reader);
+        uint8_t buttons = movie_read_value(&reader, 1);
+        if (run == 0 || run > frame_count - movie->frame_count) reader.failed = 1;
+        if (reader.failed) break;
+        memset(movie->buttons + movie->frame_count, buttons, run);
+        movie->frame_count += run;
+    }
+
+    for (uint32_t i = 0; !reader.failed && i < movie_checkpoint_count(movie); i++) {
+        movie->checkpoints[i] = movie_read_value(&reader, 8);
+    }
+
+    free(data);
+    if (reader.failed) {
+        gameboy_movie_destroy(movie);
+        return NULL;
+    }
+    return movie;
+}
+
+int gameboy_movie_replay(GameboyMovie* movie, Gameboy* gb, uint32_t* failed_frame) {
+    if (failed_frame) *failed_frame = 0;
+    if (movie->rom_hash != gameboy_rom_hash(gb)) return 1;
+    if (movie->start_state && gameboy_load_state(gb, movie->start_state, movie->start_state_size)) {
+        return 1;
+    }
+
+    for (uint32_t frame = 0; frame < movie->frame_count; frame++) {
+        gameboy_single_frame_update(gb, movie->buttons[frame], NULL);
+
+        uint32_t frames_run = frame + 1;
+        if (movie->checkpoint_interval && frames_run % movie->checkpoint_interval == 0 &&
+                movie->checkpoints[frames_run / movie->checkpoint_interval - 1] != gameboy_state_hash(gb)) {
+            if (failed_frame) *failed_frame = frames_run;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#ifndef SRC_COMMON_GAMEBOY_MOVIE_H_
+#define SRC_COMMON_GAMEBOY_MOVIE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gameboy.h"
+
+#define GAMEBOY_MOVIE_MAGIC 0x564D4247  // "GBMV"
+#define GAMEBOY_MOVIE_VERSION 4
+
+/** Recording of the buttons pressed on each frame of a run, enough to replay it exactly.
+ *
+ *  In a file all values are little endian. The header holds the magic, version, a hash of the
+ *  cartridge ROM, the checkpoint interval, the number of frames and the size of the initial
+ *  state, 0 if the run started at power on, followed by the state itself. Then come the
+ *  buttons as runs of a length and the button byte repeated that many frames, and last the
+ *  checkpoint hashes.
+*/
+typedef struct gameboy_movie_t {
+    uint64_t rom_hash;
+    uint8_t* start_state;       // Serialized state the run starts from, NULL to start at power on.
+    size_t start_state_size;
+
+    uint8_t* buttons;           // Buttons of each frame.
+    uint32_t frame_count;
+    uint32_t frame_capacity;
+
+    // Hash of the state after every checkpoint_interval-th frame, 0 for no checkpoints.
+    uint32_t checkpoint_interval;
+    uint64_t* checkpoints;
+} GameboyMovie;
+
+/** Starts recording a movie of a Gameboy from its current state.
+ *
+ * @param gb Gameboy to record.
+ * @param power_on 1 if the Gameboy is at power on, after gameboy_skip_bootstrap, so no state
+ *                 needs to be stored. 0 to store its current state.
+ * @param checkpoint_interval Number of frames between checkpoints, 0 for none.
+ * @return A pointer to the GameboyMovie created.
+*/
+GameboyMovie* gameboy_movie_create(Gameboy* gb, uint8_t power_on, uint32_t checkpoint_interval);
+
+/** Frees all memory used by the movie.
+ *
+ * @param movie GameboyMovie to destroy.
+*/
+void gameboy_movie_destroy(GameboyMovie* movie);
+
+/** Runs one frame of a Gameboy being recorded and adds it to the movie.
+ *
+ * @param movie GameboyMovie to record to.
+ * @param gb Gameboy being recorded.
+ * @param buttons State of the buttons.
+ * @param frame_buffer Frame buffer to draw the frame to, or NULL to skip drawing it.
+*/
+void gameboy_movie_record_frame(GameboyMovie* movie, Gameboy* gb, uint8_t buttons,
+                                uint8_t* frame_buffer);
+
+/** Writes a movie to a file.
+ *
+ * @param movie GameboyMovie to save.
+ * @param path Path of the file.
+ * @return 0 on success, 1 if the file could not be written.
+*/
+int gameboy_movie_save(GameboyMovie* movie, const char* path);
+
+/** Reads a movie written by gameboy_movie_save.
+ *
+ * @param path Path of the file.
+ * @return A pointer to the GameboyMovie read, or NULL if the file is not a valid movie.
+*/
+GameboyMovie* gameboy_movie_load(const char* path);
+
+/** Replays a movie as fast as possible without drawing, checking the state at each checkpoint.
+ *
+ * @param movie GameboyMovie to replay.
+ * @param gb Gameboy with the movie's ROM loaded. For movies that start at power on it must be
+ *           at power on, after gameboy_skip_bootstrap.
+ * @param failed_frame Set to the number of frames run when the replay failed, may be NULL.
+ * @return 0 if every checkpoint matched, 1 if the ROM or initial state does not match or the
+ *         replay diverged from the recording.
+*/
+int gameboy_movie_replay(GameboyMovie* movie, Gameboy* gb, uint32_t* failed_frame);
+
+#endif  // SRC_COMMON_GAMEBOY_MOVIE_H_
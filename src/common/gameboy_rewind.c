@@ -0,0 +1,246 @@
+#include "gameboy_rewind.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+#include "gameboy_state.h"
+
+// Unchanged bytes that end a run of changed ones. Shorter gaps are cheaper to store as changed.
+#define REWIND_MIN_GAP 4
+
+/** Cursor that appends bytes to the ring, dropping the oldest entries to make room. */
+typedef struct rewind_writer_t {
+    GameboyRewind* rewind;
+    uint64_t position;
+    uint8_t full;               // Set if the entry does not fit in the ring even when empty.
+} RewindWriter;
+
+
+/** Gets a little endian 32 bit value stored in the ring.
+ *
+ * @param rewind GameboyRewind to operate on.
+ * @param position Position of the value.
+ * @return The value.
+*/
+static uint32_t rewind_get32(GameboyRewind* rewind, uint64_t position) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        value |= (uint32_t) rewind->ring[(position + i) & rewind->mask] << (i*8);
+    }
+    return value;
+}
+
+/** Drops the oldest entry in the ring.
+ *
+ * @param rewind GameboyRewind to operate on.
+*/
+static void rewind_drop_oldest(GameboyRewind* rewind) {
+    rewind->tail += rewind_get32(rewind, rewind->tail) + 8;
+    rewind->count--;
+}
+
+/** Appends a byte to the ring.
+ *
+ * @param writer Writer to operate on.
+ * @param byte Byte to append.
+*/
+static void rewind_put(RewindWriter* writer, uint8_t byte) {
+    GameboyRewind* rewind = writer->rewind;
+    while (writer->position - rewind->tail > rewind->mask) {
+        if (rewind->count == 0) writer->full = 1;
+        if (writer->full) return;
+        rewind_drop_oldest(rewind);
+    }
+    rewind->ring[writer->position & rewind->mask] = byte;
+    writer->position++;
+}
+
+static void rewind_put32(RewindWriter* writer, uint32_t value) {
+    for (uint8_t i = 0; i < 4; i++) rewind_put(writer, value >> (i*8));
+}
+
+/** Appends a length to the ring, 7 bits per byte with the top bit set on all but the last.
+ *
+ * @param writer Writer to operate on.
+ * @param value Length to append.
+*/
+static void rewind_put_length(RewindWriter* writer, size_t value) {
+    while (value >= 0x80) {
+        rewind_put(writer, value | 0x80);
+        value >>= 7;
+    }
+    rewind_put(writer, value);
+}
+
+/** Reads a length written by rewind_put_length.
+ *
+ * @param rewind GameboyRewind to operate on.
+ * @param position Position of the length, advanced past it.
+ * @return The length.
+*/
+static size_t rewind_get_length(GameboyRewind* rewind, uint64_t* position) {
+    size_t value = 0;
+    uint8_t shift = 0;
+    uint8_t byte;
+    do {
+        byte = rewind->ring[(*position)++ & rewind->mask];
+        value |= (size_t) (byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+/** Appends the XOR of two buffers to the ring as pairs of a run of unchanged bytes to skip
+ *  and a run of changed bytes to XOR.
+ *
+ * @param writer Writer to operate on.
+ * @param a First buffer.
+ * @param b Second buffer.
+ * @param size Size of the buffers in bytes.
+*/
+static void rewind_encode(RewindWriter* writer, const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+        // Most of the state is unchanged, so compare 8 bytes at a time first.
+        size_t start = i;
+        while (i + 8 <= size && !memcmp(a + i, b + i, 8)) i += 8;
+        while (i < size && a[i] == b[i]) i++;
+        if (i == size) break;
+        size_t unchanged = i - start;
+
+        start = i;
+        uint8_t gap = 0;
+        while (i < size && gap < REWIND_MIN_GAP) {
+            gap = a[i] == b[i] ? gap + 1 : 0;
+            i++;
+        }
+        i -= gap;
+
+        rewind_put_length(writer, unchanged);
+        rewind_put_length(writer, i - start);
+        for (size_t j = start; j < i; j++) rewind_put(writer, a[j] ^ b[j]);
+    }
+}
+
+/** Gets the bytes of a snapshot that are recorded, the registers and the state arena.
+ *
+ * @param snapshot Snapshot to operate on.
+ * @param size Set to the number of bytes.
+ * @return Pointer to the first byte.
+*/
+static uint8_t* rewind_snapshot_bytes(GameboySnapshot* snapshot, size_t* size) {
+    *size = sizeof(GameboySnapshot) + snapshot->state_size;
+    return (uint8_t*) snapshot;
+}
+
+/** Allocates a snapshot with every byte cleared. Padding in snapshots is encoded too, so it
+ *  must start out equal.
+ *
+ * @param gb Gameboy whose state the snapshot will hold.
+ * @return A pointer to the GameboySnapshot created.
+*/
+static GameboySnapshot* rewind_snapshot_create(Gameboy* gb) {
+    GameboySnapshot* snapshot = gameboy_snapshot_create(gb);
+    size_t size;
+    uint8_t* bytes = rewind_snapshot_bytes(snapshot, &size);
+    memset(bytes, 0, size);
+    snapshot->state_size = gb->state_size;
+    return snapshot;
+}
+
+
+GameboyRewind* gameboy_rewind_create(Gameboy* gb, uint32_t interval, uint8_t capacity_log2) {
+    GameboyRewind* rewind = malloc(sizeof(GameboyRewind));
+    rewind->ring = malloc((size_t) 1 << capacity_log2);
+    rewind->mask = ((uint64_t) 1 << capacity_log2) - 1;
+    rewind->interval = interval ? interval : 1;
+    rewind->newest = rewind_snapshot_create(gb);
+    rewind->next = rewind_snapshot_create(gb);
+
+    gameboy_rewind_clear(rewind);
+    return rewind;
+}
+
+void gameboy_rewind_destroy(GameboyRewind* rewind) {
+    gameboy_snapshot_destroy(rewind->newest);
+    gameboy_snapshot_destroy(rewind->next);
+    free(rewind->ring);
+    free(rewind);
+}
+
+void gameboy_rewind_clear(GameboyRewind* rewind) {
+    rewind->head = 0;
+    rewind->tail = 0;
+    rewind->count = 0;
+    rewind->frames = 0;
+    rewind->has_snapshot = 0;
+}
+
+void gameboy_rewind_frame(GameboyRewind* rewind, Gameboy* gb) {
+    if (rewind->has_snapshot && ++rewind->frames < rewind->interval) return;
+
+    gameboy_snapshot_take(gb, rewind->next);
+    if (rewind->has_snapshot) {
+        // The entry turns the new snapshot back into the current newest one.
+        size_t size;
+        const uint8_t* next = rewind_snapshot_bytes(rewind->next, &size);
+        const uint8_t* newest = rewind_snapshot_bytes(rewind->newest, &size);
+
+        RewindWriter writer = {rewind, rewind->head, 0};
+        rewind_put32(&writer, 0);
+        rewind_encode(&writer, next, newest, size);
+        uint32_t length = writer.position - rewind->head - 4;
+        rewind_put32(&writer, length);
+
+        if (writer.full) {
+            // Too large to keep even on its own, the history is lost.
+            rewind->head = rewind->tail;
+        } else {
+            for (uint8_t i = 0; i < 4; i++) {
+                rewind->ring[(rewind->head + i) & rewind->mask] = length >> (i*8);
+            }
+            rewind->head = writer.position;
+            rewind->count++;
+        }
+    }
+
+    GameboySnapshot* newest = rewind->next;
+    rewind->next = rewind->newest;
+    rewind->newest = newest;
+    rewind->has_snapshot = 1;
+    rewind->frames = 0;
+}
+
+int gameboy_rewind_step(GameboyRewind* rewind, Gameboy* gb) {
+    if (!rewind->has_snapshot) return 1;
+
+    // A Gameboy still at the newest snapshot goes back to the one before it.
+    if (gb->cycle_count == rewind->newest->registers.cycle_count) {
+        if (rewind->count == 0) return 1;
+
+        // XOR the newest entry into the newest snapshot and pop it.
+        uint32_t length = rewind_get32(rewind, rewind->head - 4);
+        uint64_t start = rewind->head - 8 - length;
+        uint64_t position = start + 4;
+        size_t size;
+        uint8_t* newest = rewind_snapshot_bytes(rewind->newest, &size);
+        size_t offset = 0;
+        while (position < rewind->head - 4) {
+            offset += rewind_get_length(rewind, &position);
+            size_t changed = rewind_get_length(rewind, &position);
+            for (size_t i = 0; i < changed; i++) {
+                newest[offset++] ^= rewind->ring[position++ & rewind->mask];
+            }
+        }
+
+        rewind->head = start;
+        rewind->count--;
+    }
+
+    gameboy_snapshot_restore(gb, rewind->newest);
+    rewind->frames = 0;
+    return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef SRC_COMMON_GAMEBOY_REWIND_H_
+#define SRC_COMMON_GAMEBOY_REWIND_H_
+
+#include <stdint.h>
+
+#include "gameboy.h"
+#include "gameboy_state.h"
+
+/** History of snapshots of a Gameboy that it can be stepped back through.
+ *
+ *  Only the newest snapshot is kept in full. Each older snapshot is stored in a byte ring as the
+ *  XOR of it and the snapshot after it, with runs of unchanged bytes skipped, so an entry costs
+ *  about as many bytes as changed between the two. Entries are laid out as a 32 bit size, the
+ *  encoded delta and the size again, so the ring can be trimmed from the oldest end and popped
+ *  from the newest end. When the ring is full the oldest entries are dropped.
+*/
+typedef struct gameboy_rewind_t {
+    uint8_t* ring;
+    uint64_t mask;              // Capacity - 1, the capacity is a power of 2.
+    uint64_t head;              // Number of bytes ever written, the end of the newest entry.
+    uint64_t tail;              // Start of the oldest entry.
+    uint32_t count;             // Number of entries in the ring.
+
+    uint32_t interval;          // Frames between snapshots.
+    uint32_t frames;            // Frames run since the newest snapshot was taken.
+    uint8_t has_snapshot;       // Cleared until the first snapshot is taken.
+    GameboySnapshot* newest;
+    GameboySnapshot* next;      // Snapshot being taken, swapped with newest once encoded.
+} GameboyRewind;
+
+/** Allocates and creates an empty rewind history for a Gameboy.
+ *
+ * @param gb Gameboy whose state will be recorded.
+ * @param interval Number of frames between snapshots, at least 1.
+ * @param capacity_log2 Log2 of the number of bytes the ring of older snapshots holds.
+ * @return A pointer to the GameboyRewind created.
+*/
+GameboyRewind* gameboy_rewind_create(Gameboy* gb, uint32_t interval, uint8_t capacity_log2);
+
+/** Frees all memory used by the rewind history.
+ *
+ * @param rewind GameboyRewind to destroy.
+*/
+void gameboy_rewind_destroy(GameboyRewind* rewind);
+
+/** Forgets every recorded snapshot, e.g. after a state was loaded.
+ *
+ * @param rewind GameboyRewind to operate on.
+*/
+void gameboy_rewind_clear(GameboyRewind* rewind);
+
+/** Records the state of a Gameboy if a snapshot is due. Should be called after every frame.
+ *
+ * @param rewind GameboyRewind to operate on.
+ * @param gb Gameboy to record.
+*/
+void gameboy_rewind_frame(GameboyRewind* rewind, Gameboy* gb);
+
+/** Steps a Gameboy back to the newest snapshot. If the Gameboy has not run since it was taken,
+ *  it is dropped and the Gameboy goes back to the snapshot before it instead.
+ *
+ * @param rewind GameboyRewind to operate on.
+ * @param gb Gameboy to restore.
+ * @return 0 on success, 1 if there is no older state to go back to.
+*/
+int gameboy_rewind_step(GameboyRewind* rewind, Gameboy* gb);
+
+#endif  // SRC_COMMON_GAMEBOY_REWIND_H_
@@ -0,0 +1,433 @@
+#include "gameboy_state.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "block_cache.h"
+#include "cpu.h"
+#include "gameboy.h"
+#include "logging.h"
+#include "memory.h"
+#include "rom_map.h"
+#include "screen.h"
+
+// Primes of the xxHash64 algorithm, used to hash pages of the state arena.
+#define XXH_PRIME1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME3 0x165667B19E3779F9ULL
+#define XXH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME5 0x27D4EB2F165667C5ULL
+
+// Direction a StateStream moves values in.
+enum StateMode {
+    STATE_COUNT,    // Only count the bytes.
+    STATE_SAVE,     // Values are written to the buffer.
+    STATE_LOAD      // Values are read from the buffer.
+};
+
+/** Cursor into a serialized state. The same field list is used to count, save and load. */
+typedef struct state_stream_t {
+    enum StateMode mode;
+    uint8_t* buffer;
+    size_t offset;
+} StateStream;
+
+
+/** Moves an unsigned value of up to 8 bytes through a stream, least significant byte first.
+ *
+ * @param stream Stream to operate on.
+ * @param value Value to save, or set to the value loaded.
+ * @param size Size of the value in bytes.
+*/
+static void state_value(StateStream* stream, uint64_t* value, uint8_t size) {
+    for (uint8_t i = 0; i < size; i++) {
+        if (stream->mode == STATE_SAVE) {
+            stream->buffer[stream->offset + i] = *value >> (i*8);
+        } else if (stream->mode == STATE_LOAD) {
+            if (i == 0) *value = 0;
+            *value |= (uint64_t) stream->buffer[stream->offset + i] << (i*8);
+        }
+    }
+    stream->offset += size;
+}
+
+// Fixed size wrappers around state_value.
+static void state_u8(StateStream* stream, uint8_t* value) {
+    uint64_t v = *value;
+    state_value(stream, &v, 1);
+    *value = v;
+}
+
+static void state_u16(StateStream* stream, uint16_t* value) {
+    uint64_t v = *value;
+    state_value(stream, &v, 2);
+    *value = v;
+}
+
+static void state_u32(StateStream* stream, uint32_t* value) {
+    uint64_t v = *value;
+    state_value(stream, &v, 4);
+    *value = v;
+}
+
+static void state_u64(StateStream* stream, uint64_t* value) {
+    state_value(stream, value, 8);
+}
+
+/** Moves a block of bytes through a stream.
+ *
+ * @param stream Stream to operate on.
+ * @param data Bytes to save, or to load into.
+ * @param size Number of bytes.
+*/
+static void state_bytes(StateStream* stream, uint8_t* data, size_t size) {
+    if (stream->mode == STATE_SAVE) {
+        memcpy(stream->buffer + stream->offset, data, size);
+    } else if (stream->mode == STATE_LOAD) {
+        memcpy(data, stream->buffer + stream->offset, size);
+    }
+    stream->offset += size;
+}
+
+/** Copies the machine state kept outside the state arena.
+ *
+ * @param gb Gameboy to copy from.
+ * @param registers Set to the state of the Gameboy.
+*/
+static void gameboy_registers_save(Gameboy* gb, GameboyRegisters* registers) {
+    registers->current_cartridge_bank = gb->current_cartridge_bank;
+    registers->current_ram_bank = gb->current_ram_bank;
+    registers->ram_bank_writable = gb->ram_bank_writable;
+    registers->doing_rom_banking = gb->doing_rom_banking;
+    registers->int_master_enable = gb->int_master_enable;
+    registers->halted = gb->halted;
+    registers->rtc = gb->rtc;
+    registers->cycle_count = gb->cycle_count;
+    registers->instruction_count = gb->instruction_count;
+    registers->divider_base = gb->divider_base;
+    registers->timer_synced = gb->timer_synced;
+    registers->scheduler = gb->scheduler;
+}
+
+/** Restores the machine state kept outside the state arena, then rebuilds the state derived
+ *  from memory.
+ *
+ * @param gb Gameboy to restore.
+ * @param registers State to restore.
+*/
+static void gameboy_registers_load(Gameboy* gb, const GameboyRegisters* registers) {
+    gb->current_cartridge_bank = registers->current_cartridge_bank;
+    gb->current_ram_bank = registers->current_ram_bank;
+    gb->ram_bank_writable = registers->ram_bank_writable;
+    gb->doing_rom_banking = registers->doing_rom_banking;
+    gb->int_master_enable = registers->int_master_enable;
+    gb->halted = registers->halted;
+    gb->rtc = registers->rtc;
+    gb->cycle_count = registers->cycle_count;
+    gb->instruction_count = registers->instruction_count;
+    gb->divider_base = registers->divider_base;
+    gb->timer_synced = registers->timer_synced;
+    gb->scheduler = registers->scheduler;
+    scheduler_update_next(&gb->scheduler);  // Saved states only hold the deadlines.
+
+    memory_map_update(gb);
+    gameboy_invalidate_state_hash(gb);
+    screen_tile_cache_invalidate(gb->tile_cache);
+    if (gb->block_cache) block_cache_invalidate_ram(gb->block_cache);
+}
+
+
+GameboySnapshot* gameboy_snapshot_create(Gameboy* gb) {
+    GameboySnapshot* snapshot = malloc(sizeof(GameboySnapshot) + gb->state_size);
+    snapshot->state_size = gb->state_size;
+    return snapshot;
+}
+
+void gameboy_snapshot_destroy(GameboySnapshot* snapshot) {
+    free(snapshot);
+}
+
+void gameboy_snapshot_take(Gameboy* gb, GameboySnapshot* snapshot) {
+    if (snapshot->state_size != gb->state_size) {
+        LOG_ERROR("Snapshot of %u bytes does not fit a state of %u bytes", snapshot->state_size, gb->state_size);
+        exit(1);
+    }
+    gameboy_registers_save(gb, &snapshot->registers);
+    gameboy_copy_state(gb, snapshot->state);
+}
+
+void gameboy_snapshot_restore(Gameboy* gb, const GameboySnapshot* snapshot) {
+    if (snapshot->state_size != gb->state_size) {
+        LOG_ERROR("Snapshot of %u bytes does not fit a state of %u bytes", snapshot->state_size, gb->state_size);
+        exit(1);
+    }
+    gameboy_unshare_state(gb);
+    memcpy(gb->state, snapshot->state, gb->state_size);
+    gameboy_registers_load(gb, &snapshot->registers);
+}
+
+void gameboy_run_ahead(Gameboy* gb, GameboySnapshot* snapshot, uint8_t buttons, uint32_t frames,
+                       uint8_t* frame_buffer) {
+    if (frames == 0) {
+        gameboy_single_frame_update(gb, buttons, frame_buffer);
+        return;
+    }
+
+    gameboy_single_frame_update(gb, buttons, NULL);
+    gameboy_snapshot_take(gb, snapshot);
+    for (uint32_t i = 1; i <= frames; i++) {
+        gameboy_single_frame_update(gb, buttons, i == frames ? frame_buffer : NULL);
+    }
+    gameboy_snapshot_restore(gb, snapshot);
+}
+
+
+static inline uint64_t hash_rotl(uint64_t value, uint8_t bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/** Reads 8 bytes as a little endian value, so hashes are the same on every host.
+ *
+ * @param data Bytes to read.
+ * @return The value.
+*/
+static inline uint64_t hash_read64(const uint8_t* data) {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < 8; i++) value |= (uint64_t) data[i] << (i*8);
+    return value;
+}
+
+static inline uint64_t hash_round(uint64_t accumulator, uint64_t input) {
+    return hash_rotl(accumulator + input*XXH_PRIME2, 31)*XXH_PRIME1;
+}
+
+static inline uint64_t hash_merge_round(uint64_t hash, uint64_t accumulator) {
+    return (hash ^ hash_round(0, accumulator))*XXH_PRIME1 + XXH_PRIME4;
+}
+
+/** Hashes a block of bytes with xxHash64.
+ *
+ * @param data Bytes to hash.
+ * @param size Number of bytes, a multiple of 32.
+ * @param seed Seed of the hash.
+ * @return Hash of the block.
+*/
+static inline uint64_t hash_block(const uint8_t* data, size_t size, uint64_t seed) {
+    uint64_t lanes[4] = {seed + XXH_PRIME1 + XXH_PRIME2, seed + XXH_PRIME2, seed, seed - XXH_PRIME1};
+    for (size_t stripe = 0; stripe < size; stripe += 32) {
+        for (uint8_t lane = 0; lane < 4; lane++) {
+            lanes[lane] = hash_round(lanes[lane], hash_read64(data + stripe + lane*8));
+        }
+    }
+
+    uint64_t hash = hash_rotl(lanes[0], 1) + hash_rotl(lanes[1], 7) + hash_rotl(lanes[2], 12) +
+                    hash_rotl(lanes[3], 18);
+    for (uint8_t lane = 0; lane < 4; lane++) hash = hash_merge_round(hash, lanes[lane]);
+    hash += size;
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/** Hashes a 256 byte page with xxHash64. The seed is the index of the page, so equal pages
+ *  in different places hash differently and page hashes can be combined with XOR.
+ *
+ * @param page Bytes of the page.
+ * @param seed Index of the page.
+ * @return Hash of the page.
+*/
+static uint64_t gameboy_page_hash(const uint8_t* page, uint64_t seed) {
+    return hash_block(page, 0x100, seed);
+}
+
+uint64_t gameboy_rom_hash(Gameboy* gb) {
+    if (!gb->rom_map) return 0;
+    // Every Gameboy sharing the mapping computes the same hash, so relaxed ordering is enough.
+    uint64_t hash = atomic_load_explicit(&gb->rom_map->hash, memory_order_relaxed);
+    if (!hash) {
+        hash = hash_block(gb->cartridge_rom, (size_t) gb->rom_bank_count*0x4000, 0) | 1;
+        atomic_store_explicit(&gb->rom_map->hash, hash, memory_order_relaxed);
+    }
+    return hash;
+}
+
+
+/** Gets the global checksum of the loaded cartridge, used to tell which ROM a state belongs to.
+ *
+ * @param gb Gameboy to operate on.
+ * @return The checksum, or 0 if no cartridge is loaded.
+*/
+static uint16_t gameboy_state_checksum(Gameboy* gb) {
+    if (!gb->cartridge_rom) return 0;
+    return (gb->cartridge_rom[0x14E] << 8) | gb->cartridge_rom[0x14F];
+}
+
+/** Moves the header of a serialized state through a stream.
+ *
+ * @param stream Stream to operate on.
+ * @param magic Magic number.
+ * @param version Version of the format.
+ * @param ram_bank_count Number of cartridge RAM banks.
+ * @param checksum Global checksum of the cartridge.
+*/
+static void gameboy_state_header(StateStream* stream, uint32_t* magic, uint16_t* version,
+                                 uint8_t* ram_bank_count, uint16_t* checksum) {
+    state_u32(stream, magic);
+    state_u16(stream, version);
+    state_u8(stream, ram_bank_count);
+    state_u16(stream, checksum);
+}
+
+/** Moves the CPU registers and the machine state kept outside the state arena through a
+ *  stream.
+ *
+ * @param stream Stream to operate on.
+ * @param registers Machine state kept outside the state arena.
+ * @param cpu_registers AF, BC, DE, HL, SP and PC.
+*/
+static void gameboy_state_registers(StateStream* stream, GameboyRegisters* registers,
+                                    uint16_t* cpu_registers) {
+    for (uint8_t i = 0; i < 6; i++) state_u16(stream, &cpu_registers[i]);
+
+    state_u16(stream, &registers->current_cartridge_bank);
+    state_u8(stream, &registers->current_ram_bank);
+    state_u8(stream, &registers->ram_bank_writable);
+    state_u8(stream, &registers->doing_rom_banking);
+    state_u8(stream, &registers->int_master_enable);
+    state_u8(stream, &registers->halted);
+
+    state_bytes(stream, registers->rtc.registers, RTC_REGISTER_COUNT);
+    state_bytes(stream, registers->rtc.latched, RTC_REGISTER_COUNT);
+    state_u8(stream, &registers->rtc.latch_state);
+    state_u8(stream, &registers->rtc.selected);
+    state_u32(stream, &registers->rtc.cycles);
+
+    state_u64(stream, &registers->cycle_count);
+    state_u64(stream, &registers->instruction_count);
+    state_u64(stream, &registers->divider_base);
+    state_u64(stream, &registers->timer_synced);
+    for (uint8_t event = 0; event < EVENT_COUNT; event++) {
+        state_u64(stream, &registers->scheduler.deadlines[event]);
+    }
+}
+
+/** Moves the body of a serialized state through a stream.
+ *
+ * @param stream Stream to operate on.
+ * @param gb Gameboy whose memory is saved or loaded.
+ * @param registers Machine state kept outside the state arena.
+ * @param cpu_registers AF, BC, DE, HL, SP and PC.
+*/
+static void gameboy_state_body(StateStream* stream, Gameboy* gb, GameboyRegisters* registers,
+                               uint16_t* cpu_registers) {
+    gameboy_state_registers(stream, registers, cpu_registers);
+
+    // The cartridge ROM half of memory is never used.
+    state_bytes(stream, gb->memory + 0x8000, 0x8000);
+    state_bytes(stream, gb->ram_banks, gb->ram_bank_count*0x2000);
+    state_bytes(stream, gb->bootstrap_rom, 0x100);
+}
+
+uint64_t gameboy_state_hash(Gameboy* gb) {
+    gb->dirty_pages[0xFF] = 1;  // The I/O registers are written directly by the screen and timer.
+
+    // Pages from 0x8000 on, the cartridge ROM half of memory is never used.
+    uint32_t pages = (gb->bootstrap_rom - gb->memory) >> 8;
+    for (uint32_t page = 0x80; page < pages; page++) {
+        if (!gb->dirty_pages[page]) continue;
+        gb->dirty_pages[page] = 0;
+
+        const uint8_t* arena = gb->memory;
+        if (gb->shared_state && gb->shared_pages[page]) arena = gb->shared_state->arena;
+        uint64_t hash = gameboy_page_hash(arena + (page << 8), page);
+        gb->memory_hash ^= gb->page_hashes[page] ^ hash;
+        gb->page_hashes[page] = hash;
+    }
+    memory_map_clean(gb);   // Catch the next write to the pages just hashed.
+
+    // The registers are hashed as they are serialized, so the hash does not depend on the
+    // layout of the structs. The end of the buffer is left 0.
+    uint8_t registers[128] = {0};
+    StateStream stream = {STATE_SAVE, registers, 0};
+    GameboyRegisters machine_registers;
+    uint16_t cpu_registers[6] = {
+        cpu_get_value_AF(gb->cpu), cpu_get_value_BC(gb->cpu), cpu_get_value_DE(gb->cpu),
+        cpu_get_value_HL(gb->cpu), gb->cpu->SP, gb->cpu->PC
+    };
+    gameboy_registers_save(gb, &machine_registers);
+    gameboy_state_registers(&stream, &machine_registers, cpu_registers);
+
+    uint64_t hash = gb->memory_hash;
+    for (size_t i = 0; i < stream.offset; i += 8) hash = hash_round(hash, hash_read64(registers + i));
+    return hash;
+}
+
+size_t gameboy_state_size(Gameboy* gb) {
+    StateStream stream = {STATE_COUNT, NULL, 0};
+    uint32_t magic = 0;
+    uint16_t version = 0, checksum = 0;
+    uint8_t ram_bank_count = 0;
+    GameboyRegisters registers;
+    uint16_t cpu_registers[6] = {0};
+
+    memset(&registers, 0, sizeof(registers));
+    gameboy_state_header(&stream, &magic, &version, &ram_bank_count, &checksum);
+    gameboy_state_body(&stream, gb, &registers, cpu_registers);
+    return stream.offset;
+}
+
+void gameboy_save_state(Gameboy* gb, uint8_t* buffer) {
+    StateStream stream = {STATE_SAVE, buffer, 0};
+    uint32_t magic = GAMEBOY_STATE_MAGIC;
+    uint16_t version = GAMEBOY_STATE_VERSION;
+    uint8_t ram_bank_count = gb->ram_bank_count;
+    uint16_t checksum = gameboy_state_checksum(gb);
+    GameboyRegisters registers;
+    uint16_t cpu_registers[6] = {
+        cpu_get_value_AF(gb->cpu), cpu_get_value_BC(gb->cpu), cpu_get_value_DE(gb->cpu),
+        cpu_get_value_HL(gb->cpu), gb->cpu->SP, gb->cpu->PC
+    };
+
+    // The body is read straight from the state arena.
+    gameboy_unshare_state(gb);
+    gameboy_registers_save(gb, &registers);
+    gameboy_state_header(&stream, &magic, &version, &ram_bank_count, &checksum);
+    gameboy_state_body(&stream, gb, &registers, cpu_registers);
+}
+
+int gameboy_load_state(Gameboy* gb, const uint8_t* buffer, size_t size) {
+    // The buffer is only read from when loading.
+    StateStream stream = {STATE_LOAD, (uint8_t*) buffer, 0};
+    uint32_t magic;
+    uint16_t version, checksum;
+    uint8_t ram_bank_count;
+
+    if (size != gameboy_state_size(gb)) return 1;
+    gameboy_state_header(&stream, &magic, &version, &ram_bank_count, &checksum);
+    if (magic != GAMEBOY_STATE_MAGIC || version != GAMEBOY_STATE_VERSION ||
+            ram_bank_count != gb->ram_bank_count || checksum != gameboy_state_checksum(gb)) {
+        return 1;
+    }
+
+    GameboyRegisters registers;
+    uint16_t cpu_registers[6];
+    gameboy_unshare_state(gb);
+    gameboy_registers_save(gb, &registers);
+    gameboy_state_body(&stream, gb, &registers, cpu_registers);
+
+    cpu_set_value_AF(gb->cpu, cpu_registers[0]);
+    cpu_set_value_BC(gb->cpu, cpu_registers[1]);
+    cpu_set_value_DE(gb->cpu, cpu_registers[2]);
+    cpu_set_value_HL(gb->cpu, cpu_registers[3]);
+    gb->cpu->SP = cpu_registers[4];
+    gb->cpu->PC = cpu_registers[5];
+    gameboy_registers_load(gb, &registers);
+    return 0;
+}
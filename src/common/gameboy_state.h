@@ -0,0 +1,123 @@
+#ifndef SRC_COMMON_GAMEBOY_STATE_H_
+#define SRC_COMMON_GAMEBOY_STATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gameboy.h"
+#include "mbc_struct.h"
+#include "scheduler.h"
+
+#define GAMEBOY_STATE_MAGIC 0x54534247  // "GBST"
+#define GAMEBOY_STATE_VERSION 1
+
+/** Machine state kept in the Gameboy struct rather than in the state arena. */
+typedef struct gameboy_registers_t {
+    uint16_t current_cartridge_bank;
+    uint8_t current_ram_bank;
+    uint8_t ram_bank_writable;
+    uint8_t doing_rom_banking;
+    uint8_t int_master_enable;
+    uint8_t halted;
+    RTC rtc;
+    uint64_t cycle_count;
+    uint64_t instruction_count;
+    uint64_t divider_base;
+    uint64_t timer_synced;
+    Scheduler scheduler;
+} GameboyRegisters;
+
+/** In memory copy of the state of a Gameboy. The cartridge ROM is not copied. */
+typedef struct gameboy_snapshot_t {
+    GameboyRegisters registers;
+    uint32_t state_size;
+    uint8_t state[];            // Copy of the Gameboy's state arena.
+} GameboySnapshot;
+
+/** Allocates a snapshot large enough for the state of a Gameboy. Gameboys with the same kind
+ *  of cartridge have the same state size, so the snapshot can be used with any of them.
+ *
+ * @param gb Gameboy whose state the snapshot will hold.
+ * @return A pointer to the GameboySnapshot created.
+*/
+GameboySnapshot* gameboy_snapshot_create(Gameboy* gb);
+
+/** Frees a snapshot.
+ *
+ * @param snapshot GameboySnapshot to destroy.
+*/
+void gameboy_snapshot_destroy(GameboySnapshot* snapshot);
+
+/** Copies the state of a Gameboy into a snapshot.
+ *
+ * @param gb Gameboy to operate on.
+ * @param snapshot Snapshot to write to.
+*/
+void gameboy_snapshot_take(Gameboy* gb, GameboySnapshot* snapshot);
+
+/** Restores the state of a Gameboy from a snapshot. The state arena is restored with a single
+ *  copy, derived state such as the page maps and decoded tiles is then rebuilt.
+ *
+ * @param gb Gameboy to operate on.
+ * @param snapshot Snapshot to restore.
+*/
+void gameboy_snapshot_restore(Gameboy* gb, const GameboySnapshot* snapshot);
+
+/** Runs one frame with run-ahead, hiding frames of latency in the game's response to input.
+ *  The frame is run without being drawn, then the Gameboy runs ahead a number of frames with
+ *  the same buttons and the last of them is drawn. The state is then restored from the
+ *  snapshot, so only the first frame counts.
+ *
+ * @param gb Gameboy to operate on.
+ * @param snapshot Snapshot of the Gameboy's state size to save the state in.
+ * @param buttons State of the buttons.
+ * @param frames Number of frames to run ahead, 0 runs a normal frame.
+ * @param frame_buffer Frame buffer to draw the frame to, or NULL to skip drawing it.
+*/
+void gameboy_run_ahead(Gameboy* gb, GameboySnapshot* snapshot, uint8_t buttons, uint32_t frames,
+                       uint8_t* frame_buffer);
+
+/** Hashes everything a saved state holds: the CPU registers, memory from 0x8000 on, the
+ *  cartridge RAM and the GameboyRegisters, such as IME, the halt state, banks, RTC, cycle
+ *  counts and event deadlines. Only the pages written since the last call are hashed again,
+ *  so it is cheap enough to call every frame. Writes that bypass memory_set8 must be followed
+ *  by gameboy_invalidate_state_hash.
+ *
+ * @param gb Gameboy to operate on.
+ * @return Hash of the state.
+*/
+uint64_t gameboy_state_hash(Gameboy* gb);
+
+/** Hashes the cartridge ROM of a Gameboy with xxHash64, which identifies the game loaded. The
+ *  hash is computed once per ROM mapping and shared by every Gameboy using it.
+ *
+ * @param gb Gameboy to operate on.
+ * @return Hash of the ROM, never 0, or 0 if no ROM is loaded.
+*/
+uint64_t gameboy_rom_hash(Gameboy* gb);
+
+/** Gets the size of the serialized state of a Gameboy.
+ *
+ * @param gb Gameboy to operate on.
+ * @return Size of the state in bytes.
+*/
+size_t gameboy_state_size(Gameboy* gb);
+
+/** Serializes the state of a Gameboy into a flat, versioned blob. Values are stored little
+ *  endian, so the blob can be loaded on any host.
+ *
+ * @param gb Gameboy to operate on.
+ * @param buffer Buffer to write gameboy_state_size(gb) bytes to.
+*/
+void gameboy_save_state(Gameboy* gb, uint8_t* buffer);
+
+/** Loads a state written by gameboy_save_state. The same cartridge must be loaded.
+ *
+ * @param gb Gameboy to operate on.
+ * @param buffer Serialized state.
+ * @param size Size of the serialized state in bytes.
+ * @return 0 on success, 1 if the state is not valid for the Gameboy, which is left unchanged.
+*/
+int gameboy_load_state(Gameboy* gb, const uint8_t* buffer, size_t size);
+
+#endif  // SRC_COMMON_GAMEBOY_STATE_H_
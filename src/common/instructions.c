@@ -0,0 +1,642 @@
+#include "instructions.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+#include "gameboy.h"
+#include "logging.h"
+#include "memory.h"
+
+
+// Handlers are generated per register operand so that instructions that only differ in the
+// register they operate on share a single definition. Each handler returns the number of cpu
+// cycles the instruction took to execute.
+
+#define REGISTER_HL memory_get8(gb, cpu_get_value_HL(gb->cpu))
+
+
+
+// 8 bit load instructions.
+
+#define DEFINE_LD_R_D8(r) \
+    static uint8_t instruction_ld_##r##_d8(Gameboy* gb) { \
+        gb->cpu->r = gameboy_fetch_immediate8(gb); \
+        return 8; \
+    }
+
+#define DEFINE_LD_R_R(dst, src) \
+    static uint8_t instruction_ld_##dst##_##src(Gameboy* gb) { \
+        gb->cpu->dst = gb->cpu->src; \
+        return 4; \
+    }
+
+#define DEFINE_LD_R_HL(r) \
+    static uint8_t instruction_ld_##r##_HL(Gameboy* gb) { \
+        gb->cpu->r = REGISTER_HL; \
+        return 8; \
+    }
+
+#define DEFINE_LD_HL_R(r) \
+    static uint8_t instruction_ld_HL_##r(Gameboy* gb) { \
+        memory_set8(gb, cpu_get_value_HL(gb->cpu), gb->cpu->r); \
+        return 8; \
+    }
+
+#define DEFINE_LD_R_ROW(dst) \
+    DEFINE_LD_R_D8(dst) \
+    DEFINE_LD_R_HL(dst) \
+    DEFINE_LD_HL_R(dst) \
+    DEFINE_LD_R_R(dst, A) \
+    DEFINE_LD_R_R(dst, B) \
+    DEFINE_LD_R_R(dst, C) \
+    DEFINE_LD_R_R(dst, D) \
+    DEFINE_LD_R_R(dst, E) \
+    DEFINE_LD_R_R(dst, H) \
+    DEFINE_LD_R_R(dst, L)
+
+DEFINE_LD_R_ROW(A)
+DEFINE_LD_R_ROW(B)
+DEFINE_LD_R_ROW(C)
+DEFINE_LD_R_ROW(D)
+DEFINE_LD_R_ROW(E)
+DEFINE_LD_R_ROW(H)
+DEFINE_LD_R_ROW(L)
+
+static uint8_t instruction_ld_A_BC(Gameboy* gb) {
+    gb->cpu->A = memory_get8(gb, cpu_get_value_BC(gb->cpu));
+    return 8;
+}
+
+static uint8_t instruction_ld_A_DE(Gameboy* gb) {
+    gb->cpu->A = memory_get8(gb, cpu_get_value_DE(gb->cpu));
+    return 8;
+}
+
+static uint8_t instruction_ld_BC_A(Gameboy* gb) {
+    memory_set8(gb, cpu_get_value_BC(gb->cpu), gb->cpu->A);
+    return 8;
+}
+
+static uint8_t instruction_ld_DE_A(Gameboy* gb) {
+    memory_set8(gb, cpu_get_value_DE(gb->cpu), gb->cpu->A);
+    return 8;
+}
+
+static uint8_t instruction_ld_HL_d8(Gameboy* gb) {
+    memory_set8(gb, cpu_get_value_HL(gb->cpu), gameboy_fetch_immediate8(gb));
+    return 12;
+}
+
+static uint8_t instruction_ld_A_a16(Gameboy* gb) {
+    gb->cpu->A = memory_get8(gb, gameboy_fetch_immediate16(gb));
+    return 16;
+}
+
+static uint8_t instruction_ld_a16_A(Gameboy* gb) {
+    memory_set8(gb, gameboy_fetch_immediate16(gb), gb->cpu->A);
+    return 16;
+}
+
+static uint8_t instruction_ld_A_addrC(Gameboy* gb) {
+    gb->cpu->A = memory_get8(gb, 0xFF00 | gb->cpu->C);
+    return 8;
+}
+
+static uint8_t instruction_ld_addrC_A(Gameboy* gb) {
+    memory_set8(gb, 0xFF00 | gb->cpu->C, gb->cpu->A);
+    return 8;
+}
+
+static uint8_t instruction_ldd_A_HL(Gameboy* gb) {
+    gb->cpu->A = REGISTER_HL;
+    cpu_decrement_HL(gb->cpu);
+    return 8;
+}
+
+static uint8_t instruction_ldd_HL_A(Gameboy* gb) {
+    memory_set8(gb, cpu_get_value_HL(gb->cpu), gb->cpu->A);
+    cpu_decrement_HL(gb->cpu);
+    return 8;
+}
+
+static uint8_t instruction_ldi_A_HL(Gameboy* gb) {
+    gb->cpu->A = REGISTER_HL;
+    cpu_increment_HL(gb->cpu);
+    return 8;
+}
+
+static uint8_t instruction_ldi_HL_A(Gameboy* gb) {
+    memory_set8(gb, cpu_get_value_HL(gb->cpu), gb->cpu->A);
+    cpu_increment_HL(gb->cpu);
+    return 8;
+}
+
+static uint8_t instruction_ldh_a8_A(Gameboy* gb) {
+    memory_set8(gb, 0xFF00 | gameboy_fetch_immediate8(gb), gb->cpu->A);
+    return 12;
+}
+
+static uint8_t instruction_ldh_A_a8(Gameboy* gb) {
+    gb->cpu->A = memory_get8(gb, 0xFF00 | gameboy_fetch_immediate8(gb));
+    return 12;
+}
+
+
+
+// 16 bit load instructions.
+
+#define DEFINE_LD_RR_D16(rr) \
+    static uint8_t instruction_ld_##rr##_d16(Gameboy* gb) { \
+        cpu_set_value_##rr(gb->cpu, gameboy_fetch_immediate16(gb)); \
+        return 12; \
+    }
+
+#define DEFINE_PUSH_POP(rr) \
+    static uint8_t instruction_push_##rr(Gameboy* gb) { \
+        gameboy_push16(gb, cpu_get_value_##rr(gb->cpu)); \
+        return 16; \
+    } \
+    static uint8_t instruction_pop_##rr(Gameboy* gb) { \
+        cpu_set_value_##rr(gb->cpu, gameboy_pop16(gb)); \
+        return 12; \
+    }
+
+DEFINE_LD_RR_D16(BC)
+DEFINE_LD_RR_D16(DE)
+DEFINE_LD_RR_D16(HL)
+
+DEFINE_PUSH_POP(AF)
+DEFINE_PUSH_POP(BC)
+DEFINE_PUSH_POP(DE)
+DEFINE_PUSH_POP(HL)
+
+static uint8_t instruction_ld_SP_d16(Gameboy* gb) {
+    gb->cpu->SP = gameboy_fetch_immediate16(gb);
+    return 12;
+}
+
+static uint8_t instruction_ld_SP_HL(Gameboy* gb) {
+    gb->cpu->SP = cpu_get_value_HL(gb->cpu);
+    return 8;
+}
+
+static uint8_t instruction_ldhl_SP_r8(Gameboy* gb) {
+    uint8_t value = gameboy_fetch_immediate8(gb);
+    (gb->cpu->SP & 0x0F) + (value & 0x0F) > 0x0F ? cpu_flag_setH(gb->cpu) : cpu_flag_resetH(gb->cpu);
+    (gb->cpu->SP & 0xFF) + value > 0xFF ? cpu_flag_setC(gb->cpu) : cpu_flag_resetC(gb->cpu);
+    cpu_set_value_HL(gb->cpu, gb->cpu->SP + ((int8_t) value));
+    cpu_flag_resetZ(gb->cpu);
+    cpu_flag_resetN(gb->cpu);
+    return 12;
+}
+
+static uint8_t instruction_ld_a16_SP(Gameboy* gb) {
+    memory_set16(gb, gameboy_fetch_immediate16(gb), gb->cpu->SP);
+    return 20;
+}
+
+
+
+// 8 bit ALU instructions.
+
+#define DEFINE_ALU_R(op, helper, r) \
+    static uint8_t instruction_##op##_A_##r(Gameboy* gb) { \
+        helper(gb->cpu, gb->cpu->r); \
+        return 4; \
+    }
+
+#define DEFINE_ALU(op, helper) \
+    DEFINE_ALU_R(op, helper, A) \
+    DEFINE_ALU_R(op, helper, B) \
+    DEFINE_ALU_R(op, helper, C) \
+    DEFINE_ALU_R(op, helper, D) \
+    DEFINE_ALU_R(op, helper, E) \
+    DEFINE_ALU_R(op, helper, H) \
+    DEFINE_ALU_R(op, helper, L) \
+    static uint8_t instruction_##op##_A_HL(Gameboy* gb) { \
+        helper(gb->cpu, REGISTER_HL); \
+        return 8; \
+    } \
+    static uint8_t instruction_##op##_A_d8(Gameboy* gb) { \
+        helper(gb->cpu, gameboy_fetch_immediate8(gb)); \
+        return 8; \
+    }
+
+DEFINE_ALU(add, cpu_add_to_A)
+DEFINE_ALU(adc, cpu_addcarry_to_A)
+DEFINE_ALU(sub, cpu_subtract_from_A)
+DEFINE_ALU(sbc, cpu_subtractcarry_from_A)
+DEFINE_ALU(and, cpu_and_A)
+DEFINE_ALU(or, cpu_or_A)
+DEFINE_ALU(xor, cpu_xor_A)
+DEFINE_ALU(cp, cpu_compare_A)
+
+#define DEFINE_INC_DEC_R(r) \
+    static uint8_t instruction_inc_##r(Gameboy* gb) { \
+        cpu_increment_##r(gb->cpu); \
+        return 4; \
+    } \
+    static uint8_t instruction_dec_##r(Gameboy* gb) { \
+        cpu_decrement_##r(gb->cpu); \
+        return 4; \
+    }
+
+DEFINE_INC_DEC_R(A)
+DEFINE_INC_DEC_R(B)
+DEFINE_INC_DEC_R(C)
+DEFINE_INC_DEC_R(D)
+DEFINE_INC_DEC_R(E)
+DEFINE_INC_DEC_R(H)
+DEFINE_INC_DEC_R(L)
+
+static uint8_t instruction_inc_aHL(Gameboy* gb) {
+    uint8_t current = REGISTER_HL;
+    memory_set8(gb, cpu_get_value_HL(gb->cpu), cpu_increment8_value(gb->cpu, current));
+    return 12;
+}
+
+static uint8_t instruction_dec_aHL(Gameboy* gb) {
+    uint8_t current = REGISTER_HL;
+    memory_set8(gb, cpu_get_value_HL(gb->cpu), cpu_decrement8_value(gb->cpu, current));
+    return 12;
+}
+
+
+
+// 16 bit ALU instructions.
+
+#define DEFINE_ADD_HL_RR(rr) \
+    static uint8_t instruction_add_HL_##rr(Gameboy* gb) { \
+        cpu_add16_to_HL(gb->cpu, cpu_get_value_##rr(gb->cpu)); \
+        return 8; \
+    }
+
+#define DEFINE_INC_DEC_RR(rr) \
+    static uint8_t instruction_inc_##rr(Gameboy* gb) { \
+        cpu_increment_##rr(gb->cpu); \
+        return 8; \
+    } \
+    static uint8_t instruction_dec_##rr(Gameboy* gb) { \
+        cpu_decrement_##rr(gb->cpu); \
+        return 8; \
+    }
+
+DEFINE_ADD_HL_RR(BC)
+DEFINE_ADD_HL_RR(DE)
+DEFINE_ADD_HL_RR(HL)
+
+DEFINE_INC_DEC_RR(BC)
+DEFINE_INC_DEC_RR(DE)
+DEFINE_INC_DEC_RR(HL)
+
+static uint8_t instruction_add_HL_SP(Gameboy* gb) {
+    cpu_add16_to_HL(gb->cpu, gb->cpu->SP);
+    return 8;
+}
+
+static uint8_t instruction_add_SP_r8(Gameboy* gb) {
+    uint8_t value = gameboy_fetch_immediate8(gb);
+    (gb->cpu->SP & 0x0F) + (value & 0x0F) > 0x0F ? cpu_flag_setH(gb->cpu) : cpu_flag_resetH(gb->cpu);
+    (gb->cpu->SP & 0xFF) + value > 0xFF ? cpu_flag_setC(gb->cpu) : cpu_flag_resetC(gb->cpu);
+
+    gb->cpu->SP += (int8_t) value;
+    cpu_flag_resetZ(gb->cpu);
+    cpu_flag_resetN(gb->cpu);
+    return 16;
+}
+
+static uint8_t instruction_inc_SP(Gameboy* gb) {
+    gb->cpu->SP++;
+    return 8;
+}
+
+static uint8_t instruction_dec_SP(Gameboy* gb) {
+    gb->cpu->SP--;
+    return 8;
+}
+
+
+
+// Miscellaneous instructions.
+
+static uint8_t instruction_daa(Gameboy* gb) {
+    cpu_daa(gb->cpu);
+    return 4;
+}
+
+static uint8_t instruction_cpl(Gameboy* gb) {
+    gb->cpu->A = ~gb->cpu->A;
+
+    cpu_flag_setN(gb->cpu);
+    cpu_flag_setH(gb->cpu);
+    return 4;
+}
+
+static uint8_t instruction_ccf(Gameboy* gb) {
+    cpu_flag_getC(gb->cpu) ? cpu_flag_resetC(gb->cpu) : cpu_flag_setC(gb->cpu);
+    cpu_flag_resetN(gb->cpu);
+    cpu_flag_resetH(gb->cpu);
+    return 4;
+}
+
+static uint8_t instruction_scf(Gameboy* gb) {
+    cpu_flag_setC(gb->cpu);
+    cpu_flag_resetN(gb->cpu);
+    cpu_flag_resetH(gb->cpu);
+    return 4;
+}
+
+static uint8_t instruction_nop(Gameboy* gb) {
+    (void) gb;
+    return 4;
+}
+
+static uint8_t instruction_halt(Gameboy* gb) {
+    // With interrupts disabled and one already pending, HALT does not halt and the next
+    // opcode is read twice, see gameboy_halt_idle.
+    if (gb->int_master_enable || !(gb->memory[0xFFFF] & gb->memory[0xFF0F] & 0x1F)) {
+        gb->halted = 1;
+    } else {
+        gb->halted = GAMEBOY_HALT_BUG;
+    }
+    return 4;
+}
+
+static uint8_t instruction_stop(Gameboy* gb) {
+    gameboy_fetch_immediate8(gb);   // This should be the value 0x00.
+    // TODO(mct)
+    return 4;
+}
+
+static uint8_t instruction_di(Gameboy* gb) {
+    // Warning: Timing may be wrong.
+    gb->int_master_enable = 0;
+    return 4;
+}
+
+static uint8_t instruction_ei(Gameboy* gb) {
+    // Warning: Timing may be wrong.
+    gb->int_master_enable = 1;
+    return 4;
+}
+
+static uint8_t instruction_invalid(Gameboy* gb) {
+    LOG_ERROR("Instruction %x not found.", memory_get8(gb, gb->cpu->PC-1));
+    exit(1);
+}
+
+
+
+// Rotate instructions.
+
+#define DEFINE_ROTATE_A(op, helper) \
+    static uint8_t instruction_##op(Gameboy* gb) { \
+        gb->cpu->A = helper(gb->cpu, gb->cpu->A); \
+        cpu_flag_resetZ(gb->cpu); \
+        return 4; \
+    }
+
+DEFINE_ROTATE_A(rlca, cpu_rlc_value)
+DEFINE_ROTATE_A(rla, cpu_rl_value)
+DEFINE_ROTATE_A(rrca, cpu_rrc_value)
+DEFINE_ROTATE_A(rra, cpu_rr_value)
+
+
+
+// Jumps, calls, returns and restarts.
+
+#define CONDITION_NZ (!cpu_flag_getZ(gb->cpu))
+#define CONDITION_Z (cpu_flag_getZ(gb->cpu))
+#define CONDITION_NC (!cpu_flag_getC(gb->cpu))
+#define CONDITION_C (cpu_flag_getC(gb->cpu))
+
+#define DEFINE_CONDITIONAL_FLOW(cc) \
+    static uint8_t instruction_jp_##cc##_a16(Gameboy* gb) { \
+        uint16_t address = gameboy_fetch_immediate16(gb); \
+        if (CONDITION_##cc) gb->cpu->PC = address; \
+        return 12; \
+    } \
+    static uint8_t instruction_jr_##cc##_r8(Gameboy* gb) { \
+        int8_t offset = (int8_t) gameboy_fetch_immediate8(gb); \
+        if (CONDITION_##cc) gb->cpu->PC += offset; \
+        return 8; \
+    } \
+    static uint8_t instruction_call_##cc##_a16(Gameboy* gb) { \
+        uint16_t address = gameboy_fetch_immediate16(gb); \
+        if (CONDITION_##cc) { \
+            gameboy_push16(gb, gb->cpu->PC); \
+            gb->cpu->PC = address; \
+        } \
+        return 12; \
+    } \
+    static uint8_t instruction_ret_##cc(Gameboy* gb) { \
+        if (CONDITION_##cc) gb->cpu->PC = gameboy_pop16(gb); \
+        return 8; \
+    }
+
+DEFINE_CONDITIONAL_FLOW(NZ)
+DEFINE_CONDITIONAL_FLOW(Z)
+DEFINE_CONDITIONAL_FLOW(NC)
+DEFINE_CONDITIONAL_FLOW(C)
+
+static uint8_t instruction_jp_a16(Gameboy* gb) {
+    gb->cpu->PC = gameboy_fetch_immediate16(gb);
+    return 12;
+}
+
+static uint8_t instruction_jp_HL(Gameboy* gb) {
+    gb->cpu->PC = cpu_get_value_HL(gb->cpu);
+    return 4;
+}
+
+static uint8_t instruction_jr_r8(Gameboy* gb) {
+    gb->cpu->PC += ((int8_t) gameboy_fetch_immediate8(gb));
+    return 8;
+}
+
+static uint8_t instruction_call_a16(Gameboy* gb) {
+    uint16_t address = gameboy_fetch_immediate16(gb);
+    gameboy_push16(gb, gb->cpu->PC);
+    gb->cpu->PC = address;
+    return 12;
+}
+
+static uint8_t instruction_ret(Gameboy* gb) {
+    gb->cpu->PC = gameboy_pop16(gb);
+    return 8;
+}
+
+static uint8_t instruction_reti(Gameboy* gb) {
+    gb->cpu->PC = gameboy_pop16(gb);
+
+    // Warning: Timing may be wrong.
+    gb->int_master_enable = 1;
+    return 8;
+}
+
+// WARNING: Not sure if we are pushing the correct address.
+#define DEFINE_RST(vector) \
+    static uint8_t instruction_rst_##vector##H(Gameboy* gb) { \
+        gameboy_push16(gb, gb->cpu->PC); \
+        gb->cpu->PC = 0x##vector; \
+        return 32; \
+    }
+
+DEFINE_RST(00)
+DEFINE_RST(08)
+DEFINE_RST(10)
+DEFINE_RST(18)
+DEFINE_RST(20)
+DEFINE_RST(28)
+DEFINE_RST(30)
+DEFINE_RST(38)
+
+static uint8_t instruction_cb_prefix(Gameboy* gb) {
+    uint8_t base = gameboy_fetch_immediate8(gb);
+    return gameboy_execute_cb_prefix_instruction(gb, base);
+}
+
+
+
+// CB prefix instructions.
+
+#define DEFINE_CB_ROTATE(op, helper) \
+    static uint8_t instruction_cb_##op##_A(Gameboy* gb) { gb->cpu->A = helper(gb->cpu, gb->cpu->A); return 8; } \
+    static uint8_t instruction_cb_##op##_B(Gameboy* gb) { gb->cpu->B = helper(gb->cpu, gb->cpu->B); return 8; } \
+    static uint8_t instruction_cb_##op##_C(Gameboy* gb) { gb->cpu->C = helper(gb->cpu, gb->cpu->C); return 8; } \
+    static uint8_t instruction_cb_##op##_D(Gameboy* gb) { gb->cpu->D = helper(gb->cpu, gb->cpu->D); return 8; } \
+    static uint8_t instruction_cb_##op##_E(Gameboy* gb) { gb->cpu->E = helper(gb->cpu, gb->cpu->E); return 8; } \
+    static uint8_t instruction_cb_##op##_H(Gameboy* gb) { gb->cpu->H = helper(gb->cpu, gb->cpu->H); return 8; } \
+    static uint8_t instruction_cb_##op##_L(Gameboy* gb) { gb->cpu->L = helper(gb->cpu, gb->cpu->L); return 8; } \
+    static uint8_t instruction_cb_##op##_HL(Gameboy* gb) { \
+        uint8_t value = REGISTER_HL; \
+        memory_set8(gb, cpu_get_value_HL(gb->cpu), helper(gb->cpu, value)); \
+        return 16; \
+    }
+
+DEFINE_CB_ROTATE(rlc, cpu_rlc_value)
+DEFINE_CB_ROTATE(rrc, cpu_rrc_value)
+DEFINE_CB_ROTATE(rl, cpu_rl_value)
+DEFINE_CB_ROTATE(rr, cpu_rr_value)
+DEFINE_CB_ROTATE(sla, cpu_sla_value)
+DEFINE_CB_ROTATE(sra, cpu_sra_value)
+DEFINE_CB_ROTATE(swap, cpu_swap_value)
+DEFINE_CB_ROTATE(srl, cpu_srl_value)
+
+#define DEFINE_CB_BIT_R(n, r) \
+    static uint8_t instruction_cb_bit_##n##_##r(Gameboy* gb) { \
+        cpu_test_bit_value(gb->cpu, gb->cpu->r, n); \
+        return 8; \
+    } \
+    static uint8_t instruction_cb_res_##n##_##r(Gameboy* gb) { \
+        gb->cpu->r = gb->cpu->r & ~(1 << n); \
+        return 8; \
+    } \
+    static uint8_t instruction_cb_set_##n##_##r(Gameboy* gb) { \
+        gb->cpu->r = gb->cpu->r | (1 << n); \
+        return 8; \
+    }
+
+#define DEFINE_CB_BIT(n) \
+    DEFINE_CB_BIT_R(n, A) \
+    DEFINE_CB_BIT_R(n, B) \
+    DEFINE_CB_BIT_R(n, C) \
+    DEFINE_CB_BIT_R(n, D) \
+    DEFINE_CB_BIT_R(n, E) \
+    DEFINE_CB_BIT_R(n, H) \
+    DEFINE_CB_BIT_R(n, L) \
+    static uint8_t instruction_cb_bit_##n##_HL(Gameboy* gb) { \
+        cpu_test_bit_value(gb->cpu, REGISTER_HL, n); \
+        return 16; \
+    } \
+    static uint8_t instruction_cb_res_##n##_HL(Gameboy* gb) { \
+        uint8_t value = REGISTER_HL; \
+        memory_set8(gb, cpu_get_value_HL(gb->cpu), value & ~(1 << n)); \
+        return 16; \
+    } \
+    static uint8_t instruction_cb_set_##n##_HL(Gameboy* gb) { \
+        uint8_t value = REGISTER_HL; \
+        memory_set8(gb, cpu_get_value_HL(gb->cpu), value | (1 << n)); \
+        return 16; \
+    }
+
+DEFINE_CB_BIT(0)
+DEFINE_CB_BIT(1)
+DEFINE_CB_BIT(2)
+DEFINE_CB_BIT(3)
+DEFINE_CB_BIT(4)
+DEFINE_CB_BIT(5)
+DEFINE_CB_BIT(6)
+DEFINE_CB_BIT(7)
+
+
+
+// Dispatch tables.
+
+#define TABLE_ENTRY(opcode, handler, name) [opcode] = instruction_##handler,
+
+InstructionHandler instruction_table[256] = {
+    INSTRUCTION_LIST(TABLE_ENTRY)
+    INVALID_INSTRUCTION_LIST(TABLE_ENTRY)
+};
+
+InstructionHandler cb_instruction_table[256] = {
+    CB_INSTRUCTION_LIST(TABLE_ENTRY)
+};
+
+#ifdef GAMEBOY_THREADED_DISPATCH
+
+#ifndef __GNUC__
+#error "GAMEBOY_THREADED_DISPATCH requires a compiler that supports labels as values."
+#endif
+
+// Threaded dispatch. Every instruction jumps straight to the label of the next opcode
+// instead of returning to the caller's loop, giving each opcode its own indirect branch.
+
+#define LABEL_ENTRY(opcode, handler, name) [opcode] = &&label_##handler,
+#define INVALID_LABEL_ENTRY(opcode, handler, name) [opcode] = &&label_invalid,
+
+#define LABEL_BODY(opcode, handler, name) \
+    label_##handler: \
+        instruction_cycles = instruction_##handler(gb); \
+        DISPATCH();
+
+#define DISPATCH() \
+    do { \
+        if (gameboy_end_instruction(gb, instruction_cycles) && gb->frame_complete) return; \
+        while (gb->halted) { \
+            if (gameboy_halt_idle(gb, buttons) && gb->frame_complete) return; \
+        } \
+        gameboy_update_buttons(gb, buttons); \
+        GAMEBOY_TRACE_INSTRUCTION(gb, gb->cpu->PC); \
+        GAMEBOY_PROFILE_INSTRUCTION(gb, gb->cpu->PC); \
+        goto *dispatch_table[gameboy_fetch_immediate8(gb)]; \
+    } while (0)
+
+void instructions_execute_threaded(Gameboy* gb, uint8_t buttons) {
+    static void* const dispatch_table[256] = {
+        INSTRUCTION_LIST(LABEL_ENTRY)
+        INVALID_INSTRUCTION_LIST(INVALID_LABEL_ENTRY)
+    };
+
+    uint8_t instruction_cycles;
+
+    while (gb->halted) {
+        if (gameboy_halt_idle(gb, buttons) && gb->frame_complete) return;
+    }
+
+    gameboy_update_buttons(gb, buttons);
+    GAMEBOY_TRACE_INSTRUCTION(gb, gb->cpu->PC);
+    GAMEBOY_PROFILE_INSTRUCTION(gb, gb->cpu->PC);
+    goto *dispatch_table[gameboy_fetch_immediate8(gb)];
+
+    INSTRUCTION_LIST(LABEL_BODY)
+
+label_invalid:
+    instruction_invalid(gb);
+}
+
+#undef DISPATCH
+
+#endif  // GAMEBOY_THREADED_DISPATCH
@@ -1,6 +1,10 @@
 #ifndef SRC_INSTRUCTIONS_H_
 #define SRC_INSTRUCTIONS_H_
 
+#include <stdint.h>
+
+#include "gameboy.h"
+
 // OP codes
 
 // 8 bit load instructions.
@@ -136,8 +140,8 @@
 
 #define LD_SP_HL 0xF9
 
-// Put SP + d8 into HL.
-#define LDHL_SP_d8 0xF8
+// Put SP + r8 into HL.
+#define LDHL_SP_r8 0xF8
 
 // Put SP into address (a16).
 #define LD_a16_SP 0x08
@@ -310,8 +314,8 @@
 #define ADD_HL_HL 0x29
 #define ADD_HL_SP 0x39
 
-// Add one byte signed immediate value d8 to SP.
-#define ADD_SP_d8 0xE8
+// Add one byte signed immediate value r8 to SP.
+#define ADD_SP_r8 0xE8
 
 // 16 bit Increment instructions.
 #define INC_BC 0x03
@@ -375,14 +379,14 @@
 // Jump to address stored in HL.
 #define JP_HL 0xE9
 
-// Add d8 to the current address and jump to it.
-#define JR_d8 0x18
+// Add r8 to the address of the next instruction and jump to it.
+#define JR_r8 0x18
 
-// Conditionally add d8 to the current address and jump to it.
-#define JR_NZ_a16 0x20
-#define JR_Z_a16 0x28
-#define JR_NC_a16 0x30
-#define JR_C_a16 0x38
+// Conditionally add r8 to the address of the next instruction and jump to it.
+#define JR_NZ_r8 0x20
+#define JR_Z_r8 0x28
+#define JR_NC_r8 0x30
+#define JR_C_r8 0x38
 
 
 
@@ -734,4 +738,221 @@
 #define RES_7_A 0xBF
 
 
+// Opcode map. Each entry is X(opcode, handler, mnemonic), where handler is the suffix of the
+// instruction_<handler> function in instructions.c that executes the instruction.
+
+#define LD_R_LIST(X, r) \
+    X(LD_##r##_d8, ld_##r##_d8, "LD " #r ",d8") \
+    X(LD_##r##_A, ld_##r##_A, "LD " #r ",A") \
+    X(LD_##r##_B, ld_##r##_B, "LD " #r ",B") \
+    X(LD_##r##_C, ld_##r##_C, "LD " #r ",C") \
+    X(LD_##r##_D, ld_##r##_D, "LD " #r ",D") \
+    X(LD_##r##_E, ld_##r##_E, "LD " #r ",E") \
+    X(LD_##r##_H, ld_##r##_H, "LD " #r ",H") \
+    X(LD_##r##_L, ld_##r##_L, "LD " #r ",L") \
+    X(LD_##r##_HL, ld_##r##_HL, "LD " #r ",(HL)") \
+    X(LD_HL_##r, ld_HL_##r, "LD (HL)," #r)
+
+#define ALU_LIST(X, OP, op, mnemonic) \
+    X(OP##_A_A, op##_A_A, mnemonic " A,A") \
+    X(OP##_A_B, op##_A_B, mnemonic " A,B") \
+    X(OP##_A_C, op##_A_C, mnemonic " A,C") \
+    X(OP##_A_D, op##_A_D, mnemonic " A,D") \
+    X(OP##_A_E, op##_A_E, mnemonic " A,E") \
+    X(OP##_A_H, op##_A_H, mnemonic " A,H") \
+    X(OP##_A_L, op##_A_L, mnemonic " A,L") \
+    X(OP##_A_HL, op##_A_HL, mnemonic " A,(HL)") \
+    X(OP##_A_d8, op##_A_d8, mnemonic " A,d8")
+
+#define INC_DEC_LIST(X, r) \
+    X(INC_##r, inc_##r, "INC " #r) \
+    X(DEC_##r, dec_##r, "DEC " #r)
+
+#define CONDITIONAL_FLOW_LIST(X, cc) \
+    X(JP_##cc##_a16, jp_##cc##_a16, "JP " #cc ",a16") \
+    X(JR_##cc##_r8, jr_##cc##_r8, "JR " #cc ",r8") \
+    X(CALL_##cc##_a16, call_##cc##_a16, "CALL " #cc ",a16") \
+    X(RET_##cc, ret_##cc, "RET " #cc)
+
+#define RST_LIST(X, vector) \
+    X(RST_##vector##H, rst_##vector##H, "RST " #vector "H")
+
+#define INSTRUCTION_LIST(X) \
+    LD_R_LIST(X, A) \
+    LD_R_LIST(X, B) \
+    LD_R_LIST(X, C) \
+    LD_R_LIST(X, D) \
+    LD_R_LIST(X, E) \
+    LD_R_LIST(X, H) \
+    LD_R_LIST(X, L) \
+    X(LD_A_BC, ld_A_BC, "LD A,(BC)") \
+    X(LD_A_DE, ld_A_DE, "LD A,(DE)") \
+    X(LD_BC_A, ld_BC_A, "LD (BC),A") \
+    X(LD_DE_A, ld_DE_A, "LD (DE),A") \
+    X(LD_HL_d8, ld_HL_d8, "LD (HL),d8") \
+    X(LD_A_a16, ld_A_a16, "LD A,(a16)") \
+    X(LD_a16_A, ld_a16_A, "LD (a16),A") \
+    X(LD_A_addrC, ld_A_addrC, "LD A,(0xFF00+C)") \
+    X(LD_addrC_A, ld_addrC_A, "LD (0xFF00+C),A") \
+    X(LDD_A_HL, ldd_A_HL, "LDD A,(HL)") \
+    X(LDD_HL_A, ldd_HL_A, "LDD (HL),A") \
+    X(LDI_A_HL, ldi_A_HL, "LDI A,(HL)") \
+    X(LDI_HL_A, ldi_HL_A, "LDI (HL),A") \
+    X(LDH_a8_A, ldh_a8_A, "LDH (a8),A") \
+    X(LDH_A_a8, ldh_A_a8, "LDH A,(a8)") \
+    X(LD_BC_d16, ld_BC_d16, "LD BC,d16") \
+    X(LD_DE_d16, ld_DE_d16, "LD DE,d16") \
+    X(LD_HL_d16, ld_HL_d16, "LD HL,d16") \
+    X(LD_SP_d16, ld_SP_d16, "LD SP,d16") \
+    X(LD_SP_HL, ld_SP_HL, "LD SP,HL") \
+    X(LDHL_SP_r8, ldhl_SP_r8, "LD HL,SP+r8") \
+    X(LD_a16_SP, ld_a16_SP, "LD (a16),SP") \
+    X(PUSH_AF, push_AF, "PUSH AF") \
+    X(PUSH_BC, push_BC, "PUSH BC") \
+    X(PUSH_DE, push_DE, "PUSH DE") \
+    X(PUSH_HL, push_HL, "PUSH HL") \
+    X(POP_AF, pop_AF, "POP AF") \
+    X(POP_BC, pop_BC, "POP BC") \
+    X(POP_DE, pop_DE, "POP DE") \
+    X(POP_HL, pop_HL, "POP HL") \
+    ALU_LIST(X, ADD, add, "ADD") \
+    ALU_LIST(X, ADC, adc, "ADC") \
+    ALU_LIST(X, SUB, sub, "SUB") \
+    ALU_LIST(X, SBC, sbc, "SBC") \
+    ALU_LIST(X, AND, and, "AND") \
+    ALU_LIST(X, OR, or, "OR") \
+    ALU_LIST(X, XOR, xor, "XOR") \
+    ALU_LIST(X, CP, cp, "CP") \
+    INC_DEC_LIST(X, A) \
+    INC_DEC_LIST(X, B) \
+    INC_DEC_LIST(X, C) \
+    INC_DEC_LIST(X, D) \
+    INC_DEC_LIST(X, E) \
+    INC_DEC_LIST(X, H) \
+    INC_DEC_LIST(X, L) \
+    X(INC_aHL, inc_aHL, "INC (HL)") \
+    X(DEC_aHL, dec_aHL, "DEC (HL)") \
+    X(ADD_HL_BC, add_HL_BC, "ADD HL,BC") \
+    X(ADD_HL_DE, add_HL_DE, "ADD HL,DE") \
+    X(ADD_HL_HL, add_HL_HL, "ADD HL,HL") \
+    X(ADD_HL_SP, add_HL_SP, "ADD HL,SP") \
+    X(ADD_SP_r8, add_SP_r8, "ADD SP,r8") \
+    INC_DEC_LIST(X, BC) \
+    INC_DEC_LIST(X, DE) \
+    INC_DEC_LIST(X, HL) \
+    INC_DEC_LIST(X, SP) \
+    X(DAA, daa, "DAA") \
+    X(CPL, cpl, "CPL") \
+    X(CCF, ccf, "CCF") \
+    X(SCF, scf, "SCF") \
+    X(NOP, nop, "NOP") \
+    X(HALT, halt, "HALT") \
+    X(STOP, stop, "STOP") \
+    X(DI, di, "DI") \
+    X(EI, ei, "EI") \
+    X(RLCA, rlca, "RLCA") \
+    X(RLA, rla, "RLA") \
+    X(RRCA, rrca, "RRCA") \
+    X(RRA, rra, "RRA") \
+    X(JP_a16, jp_a16, "JP a16") \
+    X(JP_HL, jp_HL, "JP (HL)") \
+    X(JR_r8, jr_r8, "JR r8") \
+    X(CALL_a16, call_a16, "CALL a16") \
+    X(RET, ret, "RET") \
+    X(RETI, reti, "RETI") \
+    CONDITIONAL_FLOW_LIST(X, NZ) \
+    CONDITIONAL_FLOW_LIST(X, Z) \
+    CONDITIONAL_FLOW_LIST(X, NC) \
+    CONDITIONAL_FLOW_LIST(X, C) \
+    RST_LIST(X, 00) \
+    RST_LIST(X, 08) \
+    RST_LIST(X, 10) \
+    RST_LIST(X, 18) \
+    RST_LIST(X, 20) \
+    RST_LIST(X, 28) \
+    RST_LIST(X, 30) \
+    RST_LIST(X, 38) \
+    X(CB_PREFIX, cb_prefix, "PREFIX CB")
+
+// Opcodes that do not exist on the gameboy's CPU.
+#define INVALID_INSTRUCTION_LIST(X) \
+    X(0xD3, invalid, "???") \
+    X(0xDB, invalid, "???") \
+    X(0xDD, invalid, "???") \
+    X(0xE3, invalid, "???") \
+    X(0xE4, invalid, "???") \
+    X(0xEB, invalid, "???") \
+    X(0xEC, invalid, "???") \
+    X(0xED, invalid, "???") \
+    X(0xF4, invalid, "???") \
+    X(0xFC, invalid, "???") \
+    X(0xFD, invalid, "???")
+
+#define CB_ROTATE_LIST(X, OP, op, mnemonic) \
+    X(OP##_B, cb_##op##_B, mnemonic " B") \
+    X(OP##_C, cb_##op##_C, mnemonic " C") \
+    X(OP##_D, cb_##op##_D, mnemonic " D") \
+    X(OP##_E, cb_##op##_E, mnemonic " E") \
+    X(OP##_H, cb_##op##_H, mnemonic " H") \
+    X(OP##_L, cb_##op##_L, mnemonic " L") \
+    X(OP##_HL, cb_##op##_HL, mnemonic " (HL)") \
+    X(OP##_A, cb_##op##_A, mnemonic " A")
+
+#define CB_BIT_R_LIST(X, n, r, operand) \
+    X(BIT_##n##_##r, cb_bit_##n##_##r, "BIT " #n "," operand) \
+    X(RES_##n##_##r, cb_res_##n##_##r, "RES " #n "," operand) \
+    X(SET_##n##_##r, cb_set_##n##_##r, "SET " #n "," operand)
+
+#define CB_BIT_LIST(X, n) \
+    CB_BIT_R_LIST(X, n, B, "B") \
+    CB_BIT_R_LIST(X, n, C, "C") \
+    CB_BIT_R_LIST(X, n, D, "D") \
+    CB_BIT_R_LIST(X, n, E, "E") \
+    CB_BIT_R_LIST(X, n, H, "H") \
+    CB_BIT_R_LIST(X, n, L, "L") \
+    CB_BIT_R_LIST(X, n, HL, "(HL)") \
+    CB_BIT_R_LIST(X, n, A, "A")
+
+#define CB_INSTRUCTION_LIST(X) \
+    CB_ROTATE_LIST(X, RLC, rlc, "RLC") \
+    CB_ROTATE_LIST(X, RRC, rrc, "RRC") \
+    CB_ROTATE_LIST(X, RL, rl, "RL") \
+    CB_ROTATE_LIST(X, RR, rr, "RR") \
+    CB_ROTATE_LIST(X, SLA, sla, "SLA") \
+    CB_ROTATE_LIST(X, SRA, sra, "SRA") \
+    CB_ROTATE_LIST(X, SWAP, swap, "SWAP") \
+    CB_ROTATE_LIST(X, SRL, srl, "SRL") \
+    CB_BIT_LIST(X, 0) \
+    CB_BIT_LIST(X, 1) \
+    CB_BIT_LIST(X, 2) \
+    CB_BIT_LIST(X, 3) \
+    CB_BIT_LIST(X, 4) \
+    CB_BIT_LIST(X, 5) \
+    CB_BIT_LIST(X, 6) \
+    CB_BIT_LIST(X, 7)
+
+
+
+/** Function that executes a single instruction.
+ *
+ * @param gb Gameboy to execute the instruction on.
+ * @return The number of cpu cycles the instruction took to execute.
+*/
+typedef uint8_t (*InstructionHandler)(Gameboy* gb);
+
+// Handler tables indexed by opcode. Entries may be replaced at runtime, e.g. with profiling handlers.
+extern InstructionHandler instruction_table[256];
+extern InstructionHandler cb_instruction_table[256];
+
+#ifdef GAMEBOY_THREADED_DISPATCH
+/** Executes instructions using threaded dispatch until the current frame is complete.
+ *  Performs the same per instruction event, interrupt and button updates as
+ *  gameboy_single_frame_update.
+ *
+ * @param gb Gameboy to execute the instructions on.
+ * @param buttons Current state of the buttons.
+*/
+void instructions_execute_threaded(Gameboy* gb, uint8_t buttons);
+#endif
+
 #endif  // SRC_INSTRUCTIONS_H_
@@ -1,10 +1,33 @@
-#ifndef SRC_COMMON_MBC_STRUCT_H_
-#define SRC_COMMON_MBC_STRUCT_H_
-
-enum MBCType {
-    ROM_ONLY,
-    MBC1,
-    MBC2
-};
-
-#endif  // SRC_COMMON_MBC_STRUCT_H_
+#ifndef SRC_COMMON_MBC_STRUCT_H_
+#define SRC_COMMON_MBC_STRUCT_H_
+
+#include <stdint.h>
+
+enum MBCType {
+    ROM_ONLY,
+    MBC1,
+    MBC2,
+    MBC3,
+    MBC5
+};
+
+// Index of each MBC3 real time clock register. Selected by writing 0x08-0x0C to the RAM bank.
+enum RTCRegister {
+    RTC_SECONDS,
+    RTC_MINUTES,
+    RTC_HOURS,
+    RTC_DAY_LOW,
+    RTC_DAY_HIGH,   // Bit 0 is bit 8 of the day counter, bit 6 halts the clock, bit 7 is day carry.
+    RTC_REGISTER_COUNT
+};
+
+/** Struct that stores the state of the MBC3 real time clock. */
+typedef struct rtc_t {
+    uint8_t registers[RTC_REGISTER_COUNT];
+    uint8_t latched[RTC_REGISTER_COUNT];
+    uint8_t latch_state;        // Last value written to the latch register.
+    uint8_t selected;           // Selected register, or RTC_REGISTER_COUNT if RAM is selected.
+    uint32_t cycles;            // Cpu cycles since the seconds register last changed.
+} RTC;
+
+#endif  // SRC_COMMON_MBC_STRUCT_H_
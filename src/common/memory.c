@@ -1,9 +1,13 @@
 #include "memory.h"
 
 #include <stdint.h>
+#include <string.h>
 
+#include "block_cache.h"
+#include "cpu.h"
 #include "gameboy.h"
 #include "mbc_struct.h"
+#include "screen.h"
 
 
 void memory_dma_transfer(Gameboy* gb, uint8_t value) {
@@ -14,7 +18,13 @@ void memory_dma_transfer(Gameboy* gb, uint8_t value) {
 }
 
 
-void memory_do_banking(Gameboy* gb, uint16_t address, uint8_t value) {
+/** Handles writes to the registers of MBC1 and MBC2 cartridges.
+ *
+ * @param gb Gameboy to operate on.
+ * @param address Address of the register.
+ * @param value Value written to the register.
+*/
+static void memory_do_banking_mbc1(Gameboy* gb, uint16_t address, uint8_t value) {
     // Enable/Disable writing to RAM bank.
     if (address < 0x2000 && (gb->mbc_type == MBC1 || gb->mbc_type == MBC2)) {
         if (gb->mbc_type == MBC2 && (address & (1 << 4))) {
@@ -38,8 +48,8 @@ void memory_do_banking(Gameboy* gb, uint16_t address, uint8_t value) {
     // Change lower ROM bank bits or RAM bank.
     } else if (address >= 0x4000 && address < 0x6000 && (gb->mbc_type == MBC1)) {
         if (gb->doing_rom_banking) {
-            gb->current_cartridge_bank &= 0x1F;  // Set upper 3 bits to zero.
-            gb->current_cartridge_bank |= (value & 0xE0);
+            gb->current_cartridge_bank &= 0x1F;  // Set upper 2 bits to zero.
+            gb->current_cartridge_bank |= (value & 0x3) << 5;
             if (gb->current_cartridge_bank == 0) gb->current_cartridge_bank = 1;
         } else {
             gb->current_ram_bank = value & 0x3;
@@ -55,51 +65,257 @@ void memory_do_banking(Gameboy* gb, uint16_t address, uint8_t value) {
     }
 }
 
-
-uint8_t memory_get8(Gameboy* gb, uint16_t address) {
-    if (address < 0x4000) {
-        if (gb->memory[0xFF50] || address >= 0x100) {
-            return gb->cartridge_rom[address];
+/** Handles writes to the registers of MBC3 cartridges.
+ *
+ * @param gb Gameboy to operate on.
+ * @param address Address of the register.
+ * @param value Value written to the register.
+*/
+static void memory_do_banking_mbc3(Gameboy* gb, uint16_t address, uint8_t value) {
+    // Enable/Disable writing to RAM bank and RTC.
+    if (address < 0x2000) {
+        gb->ram_bank_writable = (value & 0xF) == 0xA;
+    // Change ROM bank.
+    } else if (address < 0x4000) {
+        gb->current_cartridge_bank = value & 0x7F;
+        if (gb->current_cartridge_bank == 0) gb->current_cartridge_bank = 1;
+    // Change RAM bank or select RTC register.
+    } else if (address < 0x6000) {
+        if (value >= 0x08 && value <= 0x0C) {
+            gb->rtc.selected = value - 0x08;
         } else {
-            return gb->bootstrap_rom[address];
+            gb->rtc.selected = RTC_REGISTER_COUNT;
+            gb->current_ram_bank = value & 0x3;
         }
-    } else if (address < 0x8000) {
-        return gb->cartridge_rom[address-0x4000 + (gb->current_cartridge_bank*0x4000)];
-    } else if (address >= 0xA000 && address < 0xC000) {
-        return gb->ram_banks[address-0xA000 + (gb->current_ram_bank*0x2000)];
+    // Latch RTC registers on a 0 to 1 transition.
     } else {
-        return gb->memory[address];
+        if (gb->rtc.latch_state == 0 && value == 1) {
+            for (uint8_t i = 0; i < RTC_REGISTER_COUNT; i++) {
+                gb->rtc.latched[i] = gb->rtc.registers[i];
+            }
+        }
+        gb->rtc.latch_state = value;
     }
 }
 
-void memory_set8(Gameboy* gb, uint16_t address, uint8_t value) {
+/** Handles writes to the registers of MBC5 cartridges.
+ *
+ * @param gb Gameboy to operate on.
+ * @param address Address of the register.
+ * @param value Value written to the register.
+*/
+static void memory_do_banking_mbc5(Gameboy* gb, uint16_t address, uint8_t value) {
+    // Enable/Disable writing to RAM bank.
+    if (address < 0x2000) {
+        gb->ram_bank_writable = (value & 0xF) == 0xA;
+    // Change lower 8 ROM bank bits, bank 0 can be selected.
+    } else if (address < 0x3000) {
+        gb->current_cartridge_bank = (gb->current_cartridge_bank & 0x100) | value;
+    // Change ROM bank bit 8.
+    } else if (address < 0x4000) {
+        gb->current_cartridge_bank = (gb->current_cartridge_bank & 0xFF) | ((value & 0x1) << 8);
+    // Change RAM bank.
+    } else if (address < 0x6000) {
+        gb->current_ram_bank = value & 0xF;
+    }
+}
+
+void memory_do_banking(Gameboy* gb, uint16_t address, uint8_t value) {
+    switch (gb->mbc_type) {
+        case MBC1:
+        case MBC2:
+            memory_do_banking_mbc1(gb, address, value);
+            break;
+        case MBC3:
+            memory_do_banking_mbc3(gb, address, value);
+            break;
+        case MBC5:
+            memory_do_banking_mbc5(gb, address, value);
+            break;
+        case ROM_ONLY:
+            break;
+    }
+    memory_map_update(gb);
+}
+
+void memory_rtc_tick(Gameboy* gb, uint32_t cycles) {
+    RTC* rtc = &gb->rtc;
+    if (rtc->registers[RTC_DAY_HIGH] & (1 << 6)) return;     // Clock is halted.
+
+    rtc->cycles += cycles;
+    while (rtc->cycles >= CPU_FREQUENCY) {
+        rtc->cycles -= CPU_FREQUENCY;
+
+        rtc->registers[RTC_SECONDS] = (rtc->registers[RTC_SECONDS] + 1) & 0x3F;
+        if (rtc->registers[RTC_SECONDS] != 60) continue;
+        rtc->registers[RTC_SECONDS] = 0;
+
+        rtc->registers[RTC_MINUTES] = (rtc->registers[RTC_MINUTES] + 1) & 0x3F;
+        if (rtc->registers[RTC_MINUTES] != 60) continue;
+        rtc->registers[RTC_MINUTES] = 0;
+
+        rtc->registers[RTC_HOURS] = (rtc->registers[RTC_HOURS] + 1) & 0x1F;
+        if (rtc->registers[RTC_HOURS] != 24) continue;
+        rtc->registers[RTC_HOURS] = 0;
+
+        uint16_t day = rtc->registers[RTC_DAY_LOW] | ((rtc->registers[RTC_DAY_HIGH] & 0x1) << 8);
+        day++;
+        if (day > 0x1FF) {
+            day = 0;
+            rtc->registers[RTC_DAY_HIGH] |= (1 << 7);  // Day counter overflowed.
+        }
+        rtc->registers[RTC_DAY_LOW] = day & 0xFF;
+        rtc->registers[RTC_DAY_HIGH] = (rtc->registers[RTC_DAY_HIGH] & 0xFE) | (day >> 8);
+    }
+}
+
+
+/** Writes to the selected RTC register.
+ *
+ * @param gb Gameboy to operate on.
+ * @param value Value to write.
+*/
+static void memory_rtc_write(Gameboy* gb, uint8_t value) {
+    static const uint8_t register_masks[RTC_REGISTER_COUNT] = {0x3F, 0x3F, 0x1F, 0xFF, 0xC1};
+
+    gb->rtc.registers[gb->rtc.selected] = value & register_masks[gb->rtc.selected];
+    if (gb->rtc.selected == RTC_SECONDS) gb->rtc.cycles = 0;
+}
+
+/** Points a range of pages in a page map at consecutive 256 byte pages of host memory.
+ *
+ * @param map Page map to update.
+ * @param first_page Index of the first page.
+ * @param pages Number of pages to map.
+ * @param base Host memory to map the first page to, or NULL to leave the pages unmapped.
+*/
+static void memory_map_pages(uint8_t** map, uint8_t first_page, uint8_t pages, uint8_t* base) {
+    for (uint8_t i = 0; i < pages; i++) {
+        map[first_page + i] = base ? base + (i << 8) : NULL;
+    }
+}
+
+/** Points the pages of a forked Gameboy that it has not written yet at the shared arena. Their
+ *  writes go through memory_set8_slow, which gives the page its own copy first.
+ *
+ * @param gb Gameboy to operate on.
+*/
+static void memory_map_shared(Gameboy* gb) {
+    uintptr_t arena = (uintptr_t) gb->memory;
+    uintptr_t arena_size = (uintptr_t) gb->bootstrap_rom - arena;  // memory and ram_banks.
+
+    for (uint16_t i = 0xA0; i < 0xFE; i++) {
+        uintptr_t offset = (uintptr_t) gb->read_map[i] - arena;
+        if (offset < arena_size && gb->shared_pages[offset >> 8]) {
+            gb->read_map[i] = gb->shared_state->arena + offset;
+        }
+
+        offset = (uintptr_t) gb->write_map[i] - arena;
+        gb->shared_write_map[i] = NULL;
+        if (offset < arena_size && gb->shared_pages[offset >> 8]) {
+            gb->shared_write_map[i] = gb->write_map[i];
+            gb->write_map[i] = NULL;
+        }
+    }
+}
+
+void memory_map_clean(Gameboy* gb) {
+    uintptr_t arena = (uintptr_t) gb->memory;
+    uintptr_t arena_size = (uintptr_t) gb->bootstrap_rom - arena;  // memory and ram_banks.
+
+    // Writes below 0x8000 only reach the MBC.
+    for (uint16_t i = 0x80; i < 0x100; i++) {
+        if (gb->clean_write_map[i]) gb->write_map[i] = gb->clean_write_map[i];
+        gb->clean_write_map[i] = NULL;
+
+        uintptr_t offset = (uintptr_t) gb->write_map[i] - arena;
+        if (offset < arena_size && !gb->dirty_pages[offset >> 8]) {
+            gb->clean_write_map[i] = gb->write_map[i];
+            gb->write_map[i] = NULL;
+        }
+    }
+}
+
+void memory_map_update(Gameboy* gb) {
+    // Bank numbers past the end of the cartridge wrap around.
+    uint8_t* rom_bank = NULL;
+    if (gb->cartridge_rom) {
+        rom_bank = gb->cartridge_rom + (gb->current_cartridge_bank % gb->rom_bank_count)*0x4000;
+    }
+    uint8_t* ram_bank = gb->ram_banks + (gb->current_ram_bank & (gb->ram_bank_count-1))*0x2000;
+
+    // Cartridge ROM, writes go to the MBC.
+    memory_map_pages(gb->read_map, 0x00, 0x40, gb->cartridge_rom);
+    memory_map_pages(gb->read_map, 0x40, 0x40, rom_bank);
+    memory_map_pages(gb->write_map, 0x00, 0x80, NULL);
+    if (!gb->memory[0xFF50]) gb->read_map[0x00] = gb->bootstrap_rom;
+
+    // Video RAM, writes to tile data go through memory_set8_slow to update the tile cache.
+    memory_map_pages(gb->read_map, 0x80, 0x20, gb->memory + 0x8000);
+    memory_map_pages(gb->write_map, 0x80, 0x18, NULL);
+    memory_map_pages(gb->write_map, 0x98, 0x08, gb->memory + 0x9800);
+
+    // Cartridge RAM, writes while it is disabled are not visible.
+    if (gb->mbc_type == MBC3 && gb->rtc.selected < RTC_REGISTER_COUNT) {
+        // Every address reads the selected RTC register, writes set it.
+        memset(gb->rtc_page, gb->rtc.latched[gb->rtc.selected], 0x100);
+        for (uint8_t i = 0; i < 0x20; i++) gb->read_map[0xA0 + i] = gb->rtc_page;
+        memory_map_pages(gb->write_map, 0xA0, 0x20, NULL);
+    } else {
+        memory_map_pages(gb->read_map, 0xA0, 0x20, ram_bank);
+        memory_map_pages(gb->write_map, 0xA0, 0x20, gb->ram_bank_writable ? ram_bank : gb->memory + 0xA000);
+    }
+
+    // Work RAM, echo RAM and OAM.
+    memory_map_pages(gb->read_map, 0xC0, 0x3F, gb->memory + 0xC000);
+    memory_map_pages(gb->write_map, 0xC0, 0x3F, gb->memory + 0xC000);
+
+    // I/O registers and high RAM, writes may have side effects.
+    gb->read_map[0xFF] = gb->memory + 0xFF00;
+    gb->write_map[0xFF] = NULL;
+
+    if (gb->shared_state) memory_map_shared(gb);
+
+    memset(gb->clean_write_map, 0, sizeof(gb->clean_write_map));
+    memory_map_clean(gb);
+}
+
+void memory_set8_slow(Gameboy* gb, uint16_t address, uint8_t value) {
     if (address < 0x8000) {
         memory_do_banking(gb, address, value);
-    } else if (address >= 0xA000 && address < 0xC000 && gb->ram_bank_writable) {
-        gb->ram_banks[address-0xA000 + (gb->current_ram_bank*0x2000)] = value;
+    } else if (address < 0x9800) {
+        gb->memory[address] = value;
+        gb->dirty_pages[address >> 8] = 1;
+        screen_tile_cache_mark(gb->tile_cache, address);
+    } else if (gb->clean_write_map[address >> 8]) {
+        // First write to a page since the state was last hashed.
+        uint8_t* page = gb->clean_write_map[address >> 8];
+        gb->dirty_pages[(page - gb->memory) >> 8] = 1;
+        gb->clean_write_map[address >> 8] = NULL;
+        gb->write_map[address >> 8] = page;
+        page[address & 0xFF] = value;
+    } else if (gb->shared_write_map[address >> 8]) {
+        // First write to a page shared with other forks.
+        uint8_t* page = gb->shared_write_map[address >> 8];
+        gb->dirty_pages[(page - gb->memory) >> 8] = 1;
+        gameboy_unshare_page(gb, page);
+        gb->write_map[address >> 8][address & 0xFF] = value;
+    } else if (address >= 0xA000 && address < 0xC000) {
+        // Only reached when an RTC register is mapped.
+        if (gb->ram_bank_writable) memory_rtc_write(gb, value);
     } else if (address == 0xFF00) {
         // Prevent buttons being overwritten.
         gb->memory[address] = (value & 0xF0) | (gb->memory[address] & 0x0F);
+    } else if (address >= 0xFF04 && address <= 0xFF07) {
+        gameboy_write_timer(gb, address, value);
     } else if (address == 0xFF46) {
         memory_dma_transfer(gb, value);
     } else if (address == 0xFF44) {
         gb->memory[0xFF44] = 0;     // Reset scanline.
+    } else if (address == 0xFF50) {
+        gb->memory[0xFF50] = value;
+        memory_map_update(gb);      // Bootstrap ROM may have been unmapped.
     } else {
         gb->memory[address] = value;
     }
 }
-
-uint16_t memory_get16(Gameboy* gb, uint16_t address) {
-    return (memory_get8(gb, address+1) << 8) | memory_get8(gb, address);
-}
-
-void memory_set16(Gameboy* gb, uint16_t address, uint16_t value) {
-    memory_set8(gb, address, value & 0xFF);
-    memory_set8(gb, address+1, value >> 8);
-    // gb->memory[address] = value & 0xFF;
-    // gb->memory[address+1] = value >> 8;
-}
-
-
-
-
@@ -2,17 +2,66 @@
 #define SRC_MEMORY_H_
 
 #include <stdint.h>
+#include "block_cache.h"
 #include "gameboy.h"
 
 
-uint8_t memory_get8(Gameboy* gb, uint16_t address);
+/** Rebuilds the read and write page maps. Must be called whenever the cartridge bank, RAM bank,
+ *  RAM enable or bootstrap ROM mapping changes.
+ *
+ * @param gb Gameboy to operate on.
+*/
+void memory_map_update(Gameboy* gb);
 
-void memory_set8(Gameboy* gb, uint16_t address, uint8_t value);
+/** Sends writes to pages of the state arena that have been hashed since they were last written
+ *  through memory_set8_slow, which marks them to be hashed again. Must be called whenever
+ *  pages are marked as hashed.
+ *
+ * @param gb Gameboy to operate on.
+*/
+void memory_map_clean(Gameboy* gb);
 
-uint16_t memory_get16(Gameboy* gb, uint16_t address);
+/** Advances the MBC3 real time clock.
+ *
+ * @param gb Gameboy to operate on.
+ * @param cycles Number of cpu cycles that have passed.
+*/
+void memory_rtc_tick(Gameboy* gb, uint32_t cycles);
 
-void memory_set16(Gameboy* gb, uint16_t address, uint16_t value);
+/** Handles writes to pages that are not plain memory, such as the MBC and I/O registers.
+ *
+ * @param gb Gameboy to operate on.
+ * @param address Address to write to.
+ * @param value Value to write.
+*/
+void memory_set8_slow(Gameboy* gb, uint16_t address, uint8_t value);
 
-#endif  // SRC_MEMORY_H_
+static inline uint8_t memory_get8(Gameboy* gb, uint16_t address) {
+    // DIV and TIMA are only brought up to date when they are read.
+    if ((uint16_t) (address - 0xFF04) < 2) gameboy_sync_timer(gb);
+    return gb->read_map[address >> 8][address & 0xFF];
+}
+
+static inline void memory_set8(Gameboy* gb, uint16_t address, uint8_t value) {
+#ifdef GAMEBOY_BLOCK_CACHE
+    block_cache_notify_write(gb, address);
+#endif
+
+    uint8_t* page = gb->write_map[address >> 8];
+    if (page) {
+        page[address & 0xFF] = value;
+    } else {
+        memory_set8_slow(gb, address, value);
+    }
+}
 
+static inline uint16_t memory_get16(Gameboy* gb, uint16_t address) {
+    return (memory_get8(gb, address+1) << 8) | memory_get8(gb, address);
+}
 
+static inline void memory_set16(Gameboy* gb, uint16_t address, uint16_t value) {
+    memory_set8(gb, address, value & 0xFF);
+    memory_set8(gb, address+1, value >> 8);
+}
+
+#endif  // SRC_MEMORY_H_
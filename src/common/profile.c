@@ -0,0 +1,279 @@
+#include "profile.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "disassembler.h"
+
+#define PROFILE_NODE_TABLE_SIZE (2*PROFILE_MAX_NODES)
+#define PROFILE_INTERRUPT 0x80000000u   // Set in the function of nodes entered by an interrupt.
+
+/** Counter with the opcode or location it counts, for sorting. */
+typedef struct profile_entry_t {
+    const ProfileCounter* counter;
+    uint32_t key;
+} ProfileEntry;
+
+
+/** Gets the bank of a location, the cartridge ROM bank for 0x4000-0x7FFF and 0 otherwise.
+ *
+ * @param bank Cartridge ROM bank mapped at 0x4000-0x7FFF.
+ * @param address Address of the location.
+ * @return The bank.
+*/
+static uint16_t profile_bank(uint16_t bank, uint16_t address) {
+    return address >= 0x4000 && address < 0x8000 ? bank & (PROFILE_ROM_BANKS-1) : 0;
+}
+
+/** Gets the counter of a location, allocating the counters of its bank if needed.
+ *
+ * @param profile Profile to operate on.
+ * @param bank Cartridge ROM bank mapped at 0x4000-0x7FFF.
+ * @param address Address of the location.
+ * @return The counter.
+*/
+static ProfileCounter* profile_location(Profile* profile, uint16_t bank, uint16_t address) {
+    if (address >= 0x8000) {
+        if (!profile->ram) profile->ram = calloc(0x8000, sizeof(ProfileCounter));
+        return profile->ram + (address - 0x8000);
+    }
+
+    bank = profile_bank(bank, address);
+    if (!profile->rom_banks[bank]) profile->rom_banks[bank] = calloc(0x4000, sizeof(ProfileCounter));
+    return profile->rom_banks[bank] + (address & 0x3FFF);
+}
+
+/** Gets the node of the call tree for a function called from another node, adding it if it
+ *  has not been called from there before.
+ *
+ * @param profile Profile to operate on.
+ * @param parent Index of the node of the caller.
+ * @param function Bank << 16 | address of the function.
+ * @return Index of the node, or parent if the tree is full.
+*/
+static uint32_t profile_child(Profile* profile, uint32_t parent, uint32_t function) {
+    uint32_t slot = (parent*0x9E3779B1u ^ function*0x85EBCA77u) & (PROFILE_NODE_TABLE_SIZE-1);
+    while (profile->node_table[slot]) {
+        ProfileNode* node = &profile->nodes[profile->node_table[slot] - 1];
+        if (node->parent == parent && node->function == function) return profile->node_table[slot] - 1;
+        slot = (slot + 1) & (PROFILE_NODE_TABLE_SIZE-1);
+    }
+
+    if (profile->node_count == PROFILE_MAX_NODES) return parent;
+    ProfileNode* node = &profile->nodes[profile->node_count];
+    node->parent = parent;
+    node->function = function;
+    node->cycles = 0;
+    profile->node_table[slot] = ++profile->node_count;
+    return profile->node_count - 1;
+}
+
+/** Gets the node of the call tree the cpu is currently in.
+ *
+ * @param profile Profile to operate on.
+ * @return Index of the node.
+*/
+static uint32_t profile_current_node(Profile* profile) {
+    return profile->depth ? profile->frames[profile->depth - 1].node : 0;
+}
+
+/** Pushes a call onto the call stack.
+ *
+ * @param profile Profile to operate on.
+ * @param function Bank << 16 | address of the function called.
+ * @param sp Stack pointer after the return address was pushed.
+*/
+static void profile_push(Profile* profile, uint32_t function, uint16_t sp) {
+    if (profile->depth == PROFILE_MAX_DEPTH) return;
+    uint32_t node = profile_child(profile, profile_current_node(profile), function);
+    profile->frames[profile->depth++] = (ProfileFrame) {node, sp};
+}
+
+static int profile_entry_compare(const void* a, const void* b) {
+    const ProfileCounter* x = ((const ProfileEntry*) a)->counter;
+    const ProfileCounter* y = ((const ProfileEntry*) b)->counter;
+    if (x->cycles != y->cycles) return x->cycles < y->cycles ? 1 : -1;
+    if (x->executions != y->executions) return x->executions < y->executions ? 1 : -1;
+    return 0;
+}
+
+/** Gets the mnemonic of an opcode.
+ *
+ * @param opcode Opcode, CB prefixed ones from 0x100.
+ * @return The mnemonic.
+*/
+static const char* profile_mnemonic(uint16_t opcode) {
+    return opcode >= 0x100 ? cb_instruction_names[opcode & 0xFF] : instruction_names[opcode];
+}
+
+/** Writes a line of the report for a counter.
+ *
+ * @param fp File to write to.
+ * @param counter Counter to write.
+ * @param total_cycles Cycles of the whole profile.
+*/
+static void profile_write_counter(FILE* fp, const ProfileCounter* counter, uint64_t total_cycles) {
+    fprintf(fp, "%14llu %6.2f%% %14llu  ", (unsigned long long) counter->cycles,
+            total_cycles ? 100.0 * counter->cycles / total_cycles : 0.0,
+            (unsigned long long) counter->executions);
+}
+
+/** Writes the name of a function of the call tree.
+ *
+ * @param fp File to write to.
+ * @param function Function of a node.
+*/
+static void profile_write_function(FILE* fp, uint32_t function) {
+    if (function & PROFILE_INTERRUPT) fprintf(fp, "IRQ ");
+    fprintf(fp, "%02X:%04X", (function >> 16) & 0x7FFF, function & 0xFFFF);
+}
+
+
+Profile* profile_create(void) {
+    Profile* profile = calloc(1, sizeof(Profile));
+    profile->nodes = malloc(PROFILE_MAX_NODES * sizeof(ProfileNode));
+    profile->node_table = calloc(PROFILE_NODE_TABLE_SIZE, sizeof(uint32_t));
+
+    // The root, code run outside any call.
+    profile->nodes[0] = (ProfileNode) {0, 0, 0};
+    profile->node_count = 1;
+    return profile;
+}
+
+void profile_destroy(Profile* profile) {
+    if (!profile) return;
+    for (uint32_t i = 0; i < PROFILE_ROM_BANKS; i++) free(profile->rom_banks[i]);
+    free(profile->ram);
+    free(profile->nodes);
+    free(profile->node_table);
+    free(profile);
+}
+
+void profile_begin(Profile* profile, uint16_t bank, uint16_t pc, uint16_t sp, uint16_t opcode) {
+    profile->location = profile_location(profile, bank, pc);
+    profile->opcode = opcode;
+    profile->sp = sp;
+}
+
+void profile_end(Profile* profile, uint16_t bank, uint16_t pc, uint16_t sp, uint8_t cycles) {
+    ProfileCounter* location = profile->location;
+    if (!location) return;
+    location->executions++;
+    location->cycles += cycles;
+    location->opcode = profile->opcode;
+    profile->opcodes[profile->opcode].executions++;
+    profile->opcodes[profile->opcode].cycles += cycles;
+    profile->nodes[profile_current_node(profile)].cycles += cycles;
+
+    switch (profile->opcode) {
+        // CALL, CALL cc and RST, taken if they pushed a return address.
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            if (sp == (uint16_t) (profile->sp - 2)) {
+                profile_push(profile, (uint32_t) profile_bank(bank, pc) << 16 | pc, sp);
+            }
+            break;
+
+        // RET, RET cc and RETI, taken if they popped a return address. Frames whose return
+        // address is below it were abandoned by code that moved the stack pointer itself.
+        case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9:
+            if (sp == (uint16_t) (profile->sp + 2)) {
+                while (profile->depth && profile->frames[profile->depth - 1].sp <= profile->sp) {
+                    profile->depth--;
+                }
+            }
+            break;
+    }
+}
+
+void profile_interrupt(Profile* profile, uint16_t vector, uint16_t sp) {
+    profile_push(profile, PROFILE_INTERRUPT | vector, sp);
+}
+
+void profile_idle(Profile* profile, uint64_t cycles) {
+    if (!profile->location) return;
+    profile->location->cycles += cycles;
+    profile->opcodes[profile->opcode].cycles += cycles;
+    profile->nodes[profile_current_node(profile)].cycles += cycles;
+    profile->idle_cycles += cycles;
+}
+
+void profile_write_report(Profile* profile, FILE* fp, uint32_t max_locations) {
+    ProfileEntry opcodes[0x200];
+    uint32_t opcode_count = 0;
+    uint64_t total_cycles = 0;
+    uint64_t total_executions = 0;
+    for (uint32_t i = 0; i < 0x200; i++) {
+        if (!profile->opcodes[i].executions) continue;
+        opcodes[opcode_count++] = (ProfileEntry) {&profile->opcodes[i], i};
+        total_cycles += profile->opcodes[i].cycles;
+        total_executions += profile->opcodes[i].executions;
+    }
+    qsort(opcodes, opcode_count, sizeof(ProfileEntry), profile_entry_compare);
+
+    fprintf(fp, "instructions:  %llu\n", (unsigned long long) total_executions);
+    fprintf(fp, "cycles:        %llu\n", (unsigned long long) total_cycles);
+    fprintf(fp, "halted:        %llu\n", (unsigned long long) profile->idle_cycles);
+    fprintf(fp, "call stacks:   %u\n\n", profile->node_count);
+
+    fprintf(fp, "Opcodes by cycles\n");
+    fprintf(fp, "%14s %7s %14s  %-6s %s\n", "cycles", "", "executions", "opcode", "mnemonic");
+    for (uint32_t i = 0; i < opcode_count; i++) {
+        profile_write_counter(fp, opcodes[i].counter, total_cycles);
+        uint32_t opcode = opcodes[i].key;
+        if (opcode >= 0x100) {
+            fprintf(fp, "CB %02X  %s\n", opcode & 0xFF, profile_mnemonic(opcode));
+        } else {
+            fprintf(fp, "%02X     %s\n", opcode, profile_mnemonic(opcode));
+        }
+    }
+
+    // Every location executed, bank 0 of the ROM holds 0x0000-0x3FFF and ram 0x8000-0xFFFF.
+    size_t location_count = 0;
+    size_t location_capacity = 0x1000;
+    ProfileEntry* locations = malloc(location_capacity * sizeof(ProfileEntry));
+    for (uint32_t bank = 0; bank <= PROFILE_ROM_BANKS; bank++) {
+        const ProfileCounter* counters = bank < PROFILE_ROM_BANKS ? profile->rom_banks[bank] : profile->ram;
+        if (!counters) continue;
+
+        uint32_t size = bank < PROFILE_ROM_BANKS ? 0x4000 : 0x8000;
+        uint32_t base = bank == PROFILE_ROM_BANKS ? 0x8000 : bank ? 0x4000 : 0;
+        for (uint32_t i = 0; i < size; i++) {
+            if (!counters[i].executions) continue;
+            if (location_count == location_capacity) {
+                location_capacity *= 2;
+                locations = realloc(locations, location_capacity * sizeof(ProfileEntry));
+            }
+            uint32_t location_bank = bank == PROFILE_ROM_BANKS ? 0 : bank;
+            locations[location_count++] = (ProfileEntry) {&counters[i], location_bank << 16 | (base + i)};
+        }
+    }
+    qsort(locations, location_count, sizeof(ProfileEntry), profile_entry_compare);
+
+    fprintf(fp, "\nLocations by cycles\n");
+    fprintf(fp, "%14s %7s %14s  %-9s %s\n", "cycles", "", "executions", "location", "mnemonic");
+    for (size_t i = 0; i < location_count && i < max_locations; i++) {
+        profile_write_counter(fp, locations[i].counter, total_cycles);
+        fprintf(fp, "%02X:%04X   %s\n", locations[i].key >> 16, locations[i].key & 0xFFFF,
+                profile_mnemonic(locations[i].counter->opcode));
+    }
+    free(locations);
+}
+
+void profile_write_folded(Profile* profile, FILE* fp) {
+    uint32_t stack[PROFILE_MAX_DEPTH + 1];
+    for (uint32_t i = 0; i < profile->node_count; i++) {
+        if (!profile->nodes[i].cycles) continue;
+
+        uint32_t depth = 0;
+        for (uint32_t node = i; node; node = profile->nodes[node].parent) stack[depth++] = node;
+
+        fprintf(fp, "root");
+        while (depth) {
+            fputc(';', fp);
+            profile_write_function(fp, profile->nodes[stack[--depth]].function);
+        }
+        fprintf(fp, " %llu\n", (unsigned long long) profile->nodes[i].cycles);
+    }
+}
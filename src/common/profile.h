@@ -0,0 +1,120 @@
+#ifndef SRC_COMMON_PROFILE_H_
+#define SRC_COMMON_PROFILE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROFILE_ROM_BANKS 0x200     // Most banks any supported MBC can address.
+#define PROFILE_MAX_DEPTH 256       // Deeper calls are counted in the frame of their caller.
+#define PROFILE_MAX_NODES 0x10000   // New call stacks past this are counted in their caller.
+
+/** Number of times code was executed and the cpu cycles it took. */
+typedef struct profile_counter_t {
+    uint64_t executions;
+    uint64_t cycles;
+    uint16_t opcode;            // Opcode last executed there, CB prefixed ones from 0x100.
+} ProfileCounter;
+
+/** Node of the call tree, one for every distinct call stack seen. */
+typedef struct profile_node_t {
+    uint32_t parent;
+    uint32_t function;          // Bank << 16 | address of the entry point, see profile_function.
+    uint64_t cycles;            // Cycles spent in the function itself, not its callees.
+} ProfileNode;
+
+/** Call on the reconstructed SM83 call stack. */
+typedef struct profile_frame_t {
+    uint32_t node;
+    uint16_t sp;                // Stack pointer after the return address was pushed.
+} ProfileFrame;
+
+/** Counts of the instructions executed by a Gameboy, by opcode, by location and by call stack.
+ *
+ *  Locations are a bank and an address. The bank is the cartridge ROM bank for 0x4000-0x7FFF
+ *  and 0 everywhere else, as in RGBDS symbol files. Calls are followed through taken CALL and
+ *  RST instructions and interrupts, and returns through taken RET and RETI instructions that
+ *  pop the return address of a frame on the stack.
+*/
+typedef struct profile_t {
+    ProfileCounter opcodes[0x200];
+    ProfileCounter* rom_banks[PROFILE_ROM_BANKS];  // 0x4000 counters each, allocated when used.
+    ProfileCounter* ram;                            // 0x8000-0xFFFF, allocated when used.
+
+    // Instruction being executed.
+    ProfileCounter* location;
+    uint16_t opcode;
+    uint16_t sp;
+    uint64_t idle_cycles;       // Cycles halted, also counted for the HALT instruction.
+
+    ProfileNode* nodes;         // Node 0 is the root, code run outside any call.
+    uint32_t node_count;
+    uint32_t* node_table;       // Open addressing table of node index + 1 by parent and function.
+    ProfileFrame frames[PROFILE_MAX_DEPTH];
+    uint32_t depth;
+} Profile;
+
+/** Allocates and creates an empty profile.
+ *
+ * @return A pointer to the Profile created.
+*/
+Profile* profile_create(void);
+
+/** Frees all memory used by the profile.
+ *
+ * @param profile Profile to destroy, may be NULL.
+*/
+void profile_destroy(Profile* profile);
+
+/** Records the start of an instruction.
+ *
+ * @param profile Profile to operate on.
+ * @param bank Cartridge ROM bank mapped at 0x4000-0x7FFF.
+ * @param pc Address of the instruction.
+ * @param sp Stack pointer before the instruction.
+ * @param opcode Opcode of the instruction, CB prefixed ones from 0x100.
+*/
+void profile_begin(Profile* profile, uint16_t bank, uint16_t pc, uint16_t sp, uint16_t opcode);
+
+/** Records the end of the instruction passed to profile_begin, following the call stack if it
+ *  was a taken call or return.
+ *
+ * @param profile Profile to operate on.
+ * @param bank Cartridge ROM bank mapped at 0x4000-0x7FFF.
+ * @param pc Address of the next instruction.
+ * @param sp Stack pointer after the instruction.
+ * @param cycles Number of cpu cycles the instruction took.
+*/
+void profile_end(Profile* profile, uint16_t bank, uint16_t pc, uint16_t sp, uint8_t cycles);
+
+/** Records a call to an interrupt routine.
+ *
+ * @param profile Profile to operate on.
+ * @param vector Address of the interrupt routine.
+ * @param sp Stack pointer after the return address was pushed.
+*/
+void profile_interrupt(Profile* profile, uint16_t vector, uint16_t sp);
+
+/** Records cycles the cpu spent halted. They are counted for the HALT instruction.
+ *
+ * @param profile Profile to operate on.
+ * @param cycles Number of cpu cycles.
+*/
+void profile_idle(Profile* profile, uint64_t cycles);
+
+/** Writes a report of the opcodes and locations that took the most cycles.
+ *
+ * @param profile Profile to operate on.
+ * @param fp File to write to.
+ * @param max_locations Maximum number of locations listed.
+*/
+void profile_write_report(Profile* profile, FILE* fp, uint32_t max_locations);
+
+/** Writes the cycles spent in each call stack in the folded format read by flamegraph.pl,
+ *  one line of functions from the outermost separated by ';' followed by the cycles.
+ *
+ * @param profile Profile to operate on.
+ * @param fp File to write to.
+*/
+void profile_write_folded(Profile* profile, FILE* fp);
+
+#endif  // SRC_COMMON_PROFILE_H_
@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "rom_map.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+RomMap* rom_map_wrap(uint8_t* data, size_t size) {
+    RomMap* rom = calloc(1, sizeof(RomMap));
+    rom->data = data;
+    rom->size = size;
+    rom->references = 1;
+    rom->allocated = 1;
+    return rom;
+}
+
+#ifdef _WIN32
+/** Windows has no mmap, so each ROM is read into its own buffer and not shared. */
+RomMap* rom_map_acquire(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+
+    RomMap* rom = calloc(1, sizeof(RomMap));
+    rom->data = malloc(size > 0 ? size : 1);
+    rom->size = fread(rom->data, 1, size > 0 ? size : 0, fp);
+    rom->references = 1;
+    rom->allocated = 1;
+    fclose(fp);
+    return rom;
+}
+
+void rom_map_retain(RomMap* rom) {
+    rom->references++;
+}
+
+void rom_map_release(RomMap* rom) {
+    if (--rom->references) return;
+    free(rom->data);
+    free(rom);
+}
+
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Every ROM file currently mapped, guarded by maps_lock.
+static RomMap* maps = NULL;
+static pthread_mutex_t maps_lock = PTHREAD_MUTEX_INITIALIZER;
+
+RomMap* rom_map_acquire(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&maps_lock);
+    RomMap* rom = maps;
+    while (rom && (rom->device != (uint64_t) st.st_dev || rom->inode != (uint64_t) st.st_ino)) {
+        rom = rom->next;
+    }
+
+    if (rom) {
+        rom->references++;
+    } else {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            rom = calloc(1, sizeof(RomMap));
+            rom->data = data;
+            rom->size = st.st_size;
+            rom->references = 1;
+            rom->allocated = 0;
+            rom->device = st.st_dev;
+            rom->inode = st.st_ino;
+            rom->next = maps;
+            maps = rom;
+        }
+    }
+    pthread_mutex_unlock(&maps_lock);
+
+    close(fd);  // The mapping stays valid after the file is closed.
+    return rom;
+}
+
+void rom_map_retain(RomMap* rom) {
+    pthread_mutex_lock(&maps_lock);
+    rom->references++;
+    pthread_mutex_unlock(&maps_lock);
+}
+
+void rom_map_release(RomMap* rom) {
+    pthread_mutex_lock(&maps_lock);
+    if (--rom->references) {
+        pthread_mutex_unlock(&maps_lock);
+        return;
+    }
+
+    if (rom->allocated) {
+        // Wrapped buffers are not in the list of mapped files.
+        pthread_mutex_unlock(&maps_lock);
+        free(rom->data);
+        free(rom);
+        return;
+    }
+
+    RomMap** link = &maps;
+    while (*link != rom) link = &(*link)->next;
+    *link = rom->next;
+    pthread_mutex_unlock(&maps_lock);
+
+    munmap(rom->data, rom->size);
+    free(rom);
+}
+#endif
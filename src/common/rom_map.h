@@ -0,0 +1,49 @@
+#ifndef SRC_COMMON_ROM_MAP_H_
+#define SRC_COMMON_ROM_MAP_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** A read only mapping of a ROM file, shared by every Gameboy that loads the same file. Also
+ *  wraps ROMs read into allocated buffers, so forked Gameboys can share them too.
+*/
+typedef struct rom_map_t {
+    uint8_t* data;
+    size_t size;
+    uint32_t references;
+    _Atomic uint64_t hash;      // Hash of the ROM, 0 until gameboy_rom_hash computes it.
+    uint8_t allocated;  // data was allocated with malloc rather than mapped.
+    uint64_t device;    // Identifies the file the mapping was made from.
+    uint64_t inode;
+    struct rom_map_t* next;
+} RomMap;
+
+/** Gets the mapping of a ROM file, mapping the file if it is not already mapped.
+ *
+ * @param path Path of the ROM file.
+ * @return A pointer to the RomMap, or NULL if the file could not be mapped.
+*/
+RomMap* rom_map_acquire(const char* path);
+
+/** Wraps a ROM read into an allocated buffer. The RomMap takes ownership of the buffer.
+ *
+ * @param data Buffer allocated with malloc.
+ * @param size Size of the buffer in bytes.
+ * @return A pointer to the RomMap created.
+*/
+RomMap* rom_map_wrap(uint8_t* data, size_t size);
+
+/** Adds a reference to a ROM mapping.
+ *
+ * @param rom RomMap to retain.
+*/
+void rom_map_retain(RomMap* rom);
+
+/** Releases a reference to a ROM mapping, unmapping the file once it is no longer used.
+ *
+ * @param rom RomMap to release.
+*/
+void rom_map_release(RomMap* rom);
+
+#endif  // SRC_COMMON_ROM_MAP_H_
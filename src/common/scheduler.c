@@ -0,0 +1,24 @@
+#include "scheduler.h"
+
+#include <stdint.h>
+
+
+void scheduler_init(Scheduler* scheduler) {
+    for (uint8_t event = 0; event < EVENT_COUNT; event++) {
+        scheduler->deadlines[event] = SCHEDULER_NEVER;
+    }
+    scheduler->next = SCHEDULER_NEVER;
+}
+
+void scheduler_schedule(Scheduler* scheduler, enum SchedulerEvent event, uint64_t deadline) {
+    scheduler->deadlines[event] = deadline;
+    scheduler_update_next(scheduler);
+}
+
+void scheduler_update_next(Scheduler* scheduler) {
+    // There are only a few events, so the earliest is found with a scan.
+    scheduler->next = SCHEDULER_NEVER;
+    for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+        if (scheduler->deadlines[i] < scheduler->next) scheduler->next = scheduler->deadlines[i];
+    }
+}
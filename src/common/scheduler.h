@@ -0,0 +1,43 @@
+#ifndef SRC_COMMON_SCHEDULER_H_
+#define SRC_COMMON_SCHEDULER_H_
+
+#include <stdint.h>
+
+// Hardware events that happen at a known cpu cycle. Due events are run in this order.
+enum SchedulerEvent {
+    EVENT_TIMER,        // TIMA overflows.
+    EVENT_SCANLINE,     // The current scanline ends.
+    EVENT_COUNT
+};
+
+#define SCHEDULER_NEVER UINT64_MAX
+
+/** Deadlines of the hardware events, in values of the Gameboy's cycle_count. The cpu runs
+ *  without checking any other hardware state until cycle_count reaches next.
+*/
+typedef struct scheduler_t {
+    uint64_t deadlines[EVENT_COUNT];    // SCHEDULER_NEVER for events that are not scheduled.
+    uint64_t next;                      // Earliest deadline.
+} Scheduler;
+
+/** Clears every deadline.
+ *
+ * @param scheduler Scheduler to initialise.
+*/
+void scheduler_init(Scheduler* scheduler);
+
+/** Sets the deadline of an event, replacing any earlier deadline of the same event.
+ *
+ * @param scheduler Scheduler to operate on.
+ * @param event Event to schedule.
+ * @param deadline Cycle the event is due at, or SCHEDULER_NEVER to cancel it.
+*/
+void scheduler_schedule(Scheduler* scheduler, enum SchedulerEvent event, uint64_t deadline);
+
+/** Sets next to the earliest deadline, after the deadlines were changed directly.
+ *
+ * @param scheduler Scheduler to operate on.
+*/
+void scheduler_update_next(Scheduler* scheduler);
+
+#endif  // SRC_COMMON_SCHEDULER_H_
@@ -1,286 +1,507 @@
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdio.h>
-
-#include "screen.h"
-
-#define WHITE 0
-#define LIGHT_GREY 1
-#define DARK_GREY 2
-#define BLACK 3
-
-static const uint8_t pallet_bitmask_map[4] = {0b00000011, 0b00001100, 0b00110000, 0b11000000};
-
-void screen_update_tiles(uint8_t* gb_memory, uint8_t* frame_buffer) {
-    uint16_t tile_data = 0;
-    uint16_t background_memory = 0;
-    bool is_unsigned = true;
-    bool is_using_window = false;
-    // printf("yay!\n");
-    uint8_t scroll_y = gb_memory[0xFF42];
-    uint8_t scroll_x = gb_memory[0xFF43];
-    uint8_t window_y = gb_memory[0xFF4A];
-    uint8_t window_x = gb_memory[0xFF4B] - 7;
-
-    uint8_t lcd_control = gb_memory[0xFF40];
-
-    if (lcd_control & (1 << 5)) {
-        if (window_y <= gb_memory[0xFF44]) is_using_window = true;
-    }
-
-    if (lcd_control & (1 << 4)) {
-        tile_data = 0x8000;
-    } else {
-        tile_data = 0x8800;
-        is_unsigned = false;
-    }
-
-    if (!is_using_window) {
-        if (lcd_control & (1 << 3)) {
-            background_memory = 0x9C00;
-        } else {
-            background_memory = 0x9800;
-        }
-    } else {
-        if (lcd_control & (1 << 6)) {
-            background_memory = 0x9C00;
-        } else {
-            background_memory = 0x9800;
-        }
-    }
-
-    uint8_t y_pos = 0;
-
-    if (!is_using_window) {
-        y_pos = scroll_y + gb_memory[0xFF44];
-    } else {
-        y_pos = gb_memory[0xFF44] - window_y;
-    }
-
-    uint16_t tile_row = ((y_pos / 8)) * 32;  // Base row index of the tile the scan line is on.
-
-    uint8_t x_pos;
-    uint16_t tile_col;
-    uint16_t tile_address;
-    int16_t tile_num;
-    uint16_t tile_location;
-    uint8_t line;
-
-    uint8_t data1;
-    uint8_t data2;
-
-    uint8_t color_offset;
-    uint8_t color_num;
-    uint8_t color;
-
-    uint8_t y;
-    for (uint8_t x = 0; x < 160; x++) {
-        if (is_using_window && x >= window_x) {
-            x_pos = x - window_x;
-        } else {
-            x_pos = x + scroll_x;
-        }
-
-        tile_col = x_pos / 8;
-
-        tile_address = background_memory + tile_row + tile_col;
-        if (is_unsigned) {
-            tile_num = (uint8_t) gb_memory[tile_address];
-            tile_location = tile_data + (tile_num*16);
-        } else {
-            tile_num = (int8_t) gb_memory[tile_address];
-            tile_location = tile_data + ((tile_num+128)*16);
-        }
-
-        line = y_pos % 8;
-        line = line * 2;
-
-        data1 = gb_memory[tile_location+line];
-        data2 = gb_memory[tile_location+line+1];
-
-        color_offset = 7 - (x_pos % 8);
-        color_num = (((data2 >> color_offset) & 0x01) << 1) | ((data1 >> color_offset) & 0x01);
-
-        y = gb_memory[0xFF44];
-        if (y > 143 || x > 159) {
-            continue;
-        }
-
-        color = (pallet_bitmask_map[color_num] & gb_memory[0xFF47]) >> (color_num * 2);
-
-        // printf("x = %d, y = %d\n", x, y);
-
-        switch (color) {
-            case WHITE:
-                frame_buffer[3*(y*160+x)] = 255;
-                frame_buffer[3*(y*160+x)+1] = 255;
-                frame_buffer[3*(y*160+x)+2] = 255;
-                break;
-            case LIGHT_GREY:
-                frame_buffer[3*(y*160+x)] = 170;
-                frame_buffer[3*(y*160+x)+1] = 170;
-                frame_buffer[3*(y*160+x)+2] = 170;
-                break;
-            case DARK_GREY:
-                frame_buffer[3*(y*160+x)] = 85;
-                frame_buffer[3*(y*160+x)+1] = 85;
-                frame_buffer[3*(y*160+x)+2] = 85;
-                break;
-            case BLACK:
-                frame_buffer[3*(y*160+x)] = 0;
-                frame_buffer[3*(y*160+x)+1] = 0;
-                frame_buffer[3*(y*160+x)+2] = 0;
-                break;
-        }
-    }
-}
-
-
-void screen_update_sprites(uint8_t* gb_memory, uint8_t* frame_buffer) {
-    uint8_t lcd_control = gb_memory[0xFF40];
-    uint8_t sprite_height = 8;
-
-    if (lcd_control & (1 << 2)) sprite_height = 16;
-
-    for (uint8_t sprite_num = 0; sprite_num < 40; sprite_num++) {
-        uint8_t i = sprite_num*4;
-        uint8_t y_pos = gb_memory[0xFE00+i] - 16;
-        uint8_t x_pos = gb_memory[0xFE00+i+1] - 8;
-        uint8_t tile_location = gb_memory[0xFE00+i+2];
-        uint8_t attributes = gb_memory[0xFE00+i+3];
-
-        uint8_t scanline_pos = gb_memory[0xFF44];
-        // printf("scan, ypos: %d, %d\n", scanline_pos, y_pos);
-        if (scanline_pos >= y_pos && scanline_pos < y_pos+sprite_height) {
-            uint8_t sprite_line = scanline_pos - y_pos;
-
-            if (attributes & (1 << 6)) {
-                sprite_line = sprite_height - sprite_line;
-            }
-
-            uint16_t data_address = 0x8000 + (tile_location * 16) + sprite_line*2;
-            uint8_t data1 = gb_memory[data_address];
-            uint8_t data2 = gb_memory[data_address+1];
-
-            for (int8_t sprite_x = 7; sprite_x >= 0; sprite_x--) {
-                int8_t color_bit = sprite_x;
-                if (attributes & (1 << 5)) {
-                    color_bit = 7 - color_bit;
-                }
-
-                uint8_t color_num = (((data2 >> color_bit) & 0x01) << 1) | ((data1 >> color_bit) & 0x01);
-                uint16_t pallet_address = attributes & (1 << 4) ? 0xFF49 : 0xFF48;
-                uint8_t color = (pallet_bitmask_map[color_num] & gb_memory[pallet_address]) >> (color_num * 2);
-
-                if (color_num == WHITE) {
-                    continue;
-                }
-
-                uint8_t x = x_pos + (7-sprite_x);
-
-                if ((scanline_pos > 143) || x > 159) {
-                    continue;
-                }
-
-                // Handle sprite priority. Bit of a hack for now.
-                // TODO(mct): Do this properly.
-                if (attributes & (1 << 7) && frame_buffer[3*(scanline_pos*160+x)] != 255) {
-                    continue;
-                }
-
-                switch (color) {
-                    case WHITE:
-                        frame_buffer[3*(scanline_pos*160+x)] = 255;
-                        frame_buffer[3*(scanline_pos*160+x)+1] = 255;
-                        frame_buffer[3*(scanline_pos*160+x)+2] = 255;
-                        break;
-                    case LIGHT_GREY:
-                        frame_buffer[3*(scanline_pos*160+x)] = 170;
-                        frame_buffer[3*(scanline_pos*160+x)+1] = 170;
-                        frame_buffer[3*(scanline_pos*160+x)+2] = 170;
-                        break;
-                    case DARK_GREY:
-                        frame_buffer[3*(scanline_pos*160+x)] = 85;
-                        frame_buffer[3*(scanline_pos*160+x)+1] = 85;
-                        frame_buffer[3*(scanline_pos*160+x)+2] = 85;
-                        break;
-                    case BLACK:
-                        frame_buffer[3*(scanline_pos*160+x)] = 0;
-                        frame_buffer[3*(scanline_pos*160+x)+1] = 0;
-                        frame_buffer[3*(scanline_pos*160+x)+2] = 0;
-                        break;
-                }
-
-            }
-
-
-        }
-    }
-}
-
-
-void screen_update_status(uint8_t* gb_memory) {
-    uint8_t lcd_control = gb_memory[0xFF40];
-
-    if (!(lcd_control & (1 << 7))) {
-        gb_memory[0xFF44] = 0;
-        gb_memory[0xFF41] &= 0xFC;
-        gb_memory[0xFF41] |= 0x01;
-        return;
-    }
-
-    uint8_t current_mode = gb_memory[0xFF40] & 0x03;
-    uint8_t new_mode = 0;
-    bool generate_interupt = false;
-
-    if (gb_memory[0xFF44] >= 144) {
-        new_mode = 1;
-        gb_memory[0xFF41] &= 0xFC;
-        gb_memory[0xFF41] |= 0x01;
-        generate_interupt = gb_memory[0xFF41] & (1 << 4);
-    } else {
-        // TEMP
-        new_mode = 0;
-        gb_memory[0xFF41] &= ~(1 << 1);
-        gb_memory[0xFF41] &= ~0x01;
-        generate_interupt = gb_memory[0xFF41] & (1 << 3);
-    }
-    // TODO(mct): Other status stuff.
-
-    if (generate_interupt && (new_mode != current_mode)) {
-        gb_memory[0xFF0F] |= (1 << 1);
-    }
-
-    // Check conincidence flag
-    if (gb_memory[0xFF44] == gb_memory[0xFF45]) {
-        gb_memory[0xFF41] |= (1 << 2);
-        if (gb_memory[0xFF41] & (1 << 6)) {
-            gb_memory[0xFF0F] |= (1 << 1);
-        }
-        // gb_memory[0xFF0F] |= (1 << 1);
-    } else {
-        gb_memory[0xFF41] &= ~(1 << 2);
-    }
-}
-
-
-void screen_scanline_update(uint8_t* gb_memory, uint8_t* frame_buffer) {
-    screen_update_status(gb_memory);
-
-    uint8_t lcd_control = gb_memory[0xFF40];
-
-    // If LCD is disabled then we return.
-    if (!(lcd_control & (1 << 7))) {
-        return;
-    }
-
-    if (lcd_control & 0x01) screen_update_tiles(gb_memory, frame_buffer);
-    if ((lcd_control >> 1) & 0x01) screen_update_sprites(gb_memory, frame_buffer);
-
-    gb_memory[0xFF44] = (gb_memory[0xFF44] + 1) % 154;
-
-    // V-blank interupt.
-    if (gb_memory[0xFF44] == 145) gb_memory[0xFF0F] |= 0x01;
-
-
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "screen.h"
+
+#ifdef SCREEN_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#define WHITE 0
+#define LIGHT_GREY 1
+#define DARK_GREY 2
+#define BLACK 3
+
+// Default color of each shade as 0xRRGGBB.
+static const uint32_t default_pallet[4] = {0xFFFFFF, 0xAAAAAA, 0x555555, 0x000000};
+
+
+void screen_frame_output_init(FrameOutput* output, enum FrameFormat format, const uint32_t* pallet) {
+    if (!pallet) pallet = default_pallet;
+
+    output->format = format;
+    output->bytes_per_pixel = screen_frame_bytes(format) / (SCREEN_WIDTH*SCREEN_HEIGHT);
+    memset(output->pixels, 0, sizeof(output->pixels));
+
+    for (uint8_t shade = 0; shade < 4; shade++) {
+        uint8_t r = pallet[shade] >> 16;
+        uint8_t g = pallet[shade] >> 8;
+        uint8_t b = pallet[shade];
+        uint16_t rgb565 = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+        uint8_t* pixel = output->pixels[shade];
+
+        switch (format) {
+            case FRAME_RGB888:
+                pixel[0] = r;
+                pixel[1] = g;
+                pixel[2] = b;
+                break;
+            case FRAME_SHADE:
+                pixel[0] = shade;
+                break;
+            case FRAME_GRAY8:
+                pixel[0] = (r*299 + g*587 + b*114) / 1000;
+                break;
+            case FRAME_RGB565:
+                memcpy(pixel, &rgb565, sizeof(rgb565));
+                break;
+            case FRAME_RGBA32:
+                pixel[0] = r;
+                pixel[1] = g;
+                pixel[2] = b;
+                pixel[3] = 0xFF;
+                break;
+        }
+    }
+}
+
+uint32_t screen_frame_bytes(enum FrameFormat format) {
+    switch (format) {
+        case FRAME_SHADE:
+        case FRAME_GRAY8:
+            return SCREEN_WIDTH*SCREEN_HEIGHT;
+        case FRAME_RGB565:
+            return SCREEN_WIDTH*SCREEN_HEIGHT*2;
+        case FRAME_RGBA32:
+            return SCREEN_WIDTH*SCREEN_HEIGHT*4;
+        default:
+            return SCREEN_FRAME_BYTES;
+    }
+}
+
+
+TileCache* screen_tile_cache_create(void) {
+    TileCache* cache = malloc(sizeof(TileCache));
+    screen_tile_cache_invalidate(cache);
+
+    // Frame buffers start zeroed, which is black in RGB888.
+    memset(cache->shades, BLACK, sizeof(cache->shades));
+    return cache;
+}
+
+void screen_tile_cache_invalidate(TileCache* cache) {
+    memset(cache->dirty, 0xFF, sizeof(cache->dirty));
+    cache->any_dirty = 1;
+}
+
+/** Decodes every tile that has been marked as dirty.
+ *
+ * @param gb_memory Memory of the gameboy.
+ * @param cache TileCache to update.
+*/
+static void screen_tile_cache_update(uint8_t* gb_memory, TileCache* cache) {
+    for (uint16_t tile = 0; tile < TILE_COUNT; tile++) {
+        if (!(cache->dirty[tile >> 3] & (1 << (tile & 0x7)))) continue;
+
+        uint8_t* data = gb_memory + 0x8000 + tile*16;
+        for (uint8_t row = 0; row < 8; row++) {
+            uint8_t data1 = data[row*2];
+            uint8_t data2 = data[row*2+1];
+            for (uint8_t col = 0; col < 8; col++) {
+                uint8_t bit = 7 - col;
+                cache->tiles[tile][row][col] = (((data2 >> bit) & 0x01) << 1) | ((data1 >> bit) & 0x01);
+            }
+        }
+    }
+    memset(cache->dirty, 0, sizeof(cache->dirty));
+    cache->any_dirty = 0;
+}
+
+/** Maps a line of color numbers to shades through a palette.
+ *
+ * @param colors Color numbers of the line.
+ * @param pallet Palette register value.
+ * @param shades Set to the shade of each pixel.
+*/
+static void screen_map_pallet_scalar(const uint8_t* colors, uint8_t pallet, uint8_t* shades) {
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
+        shades[x] = (pallet >> (colors[x] * 2)) & 0x3;
+    }
+}
+
+/** Draws the 8 pixels of a sprite row over a line of shades. Transparent pixels and pixels
+ *  behind a non-white pixel are left unchanged.
+ *
+ * @param shades Shades of the line, starting at the first pixel of the sprite.
+ * @param colors Color numbers of the sprite row, in screen order.
+ * @param pallet Palette register value of the sprite.
+ * @param behind Whether the sprite is drawn behind non-white pixels.
+*/
+static void screen_merge_sprite_scalar(uint8_t* shades, const uint8_t* colors, uint8_t pallet, bool behind) {
+    for (uint8_t col = 0; col < 8; col++) {
+        if (colors[col] == WHITE || (behind && shades[col] != WHITE)) continue;
+        shades[col] = (pallet >> (colors[col] * 2)) & 0x3;
+    }
+}
+
+/** Expands a line of shades into RGB888 pixels.
+ *
+ * @param shades Shades of the line.
+ * @param output Output holding the color of each shade.
+ * @param rgb Frame buffer line to write to.
+*/
+static void screen_write_rgb888_scalar(const uint8_t* shades, const FrameOutput* output, uint8_t* rgb) {
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
+        const uint8_t* pixel = output->pixels[shades[x]];
+        rgb[3*x] = pixel[0];
+        rgb[3*x+1] = pixel[1];
+        rgb[3*x+2] = pixel[2];
+    }
+}
+
+/** Maps a line of shades to single byte pixels.
+ *
+ * @param shades Shades of the line.
+ * @param output Output holding the value of each shade.
+ * @param pixels Frame buffer line to write to.
+*/
+static void screen_write_gray8_scalar(const uint8_t* shades, const FrameOutput* output, uint8_t* pixels) {
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
+        pixels[x] = output->pixels[shades[x]][0];
+    }
+}
+
+const ScreenCompositor screen_compositor_scalar = {
+    screen_map_pallet_scalar, screen_merge_sprite_scalar, screen_write_rgb888_scalar, screen_write_gray8_scalar
+};
+
+#ifdef SCREEN_SSSE3
+
+/** Maps a line of color numbers to shades through a palette, 16 pixels at a time.
+ *
+ * @param colors Color numbers of the line.
+ * @param pallet Palette register value.
+ * @param shades Set to the shade of each pixel.
+*/
+__attribute__((target("ssse3")))
+static void screen_map_pallet_ssse3(const uint8_t* colors, uint8_t pallet, uint8_t* shades) {
+    __m128i lut = _mm_setr_epi8(pallet & 0x3, (pallet >> 2) & 0x3, (pallet >> 4) & 0x3, (pallet >> 6) & 0x3,
+                                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x += 16) {
+        __m128i line = _mm_loadu_si128((const __m128i*) (colors + x));
+        _mm_storeu_si128((__m128i*) (shades + x), _mm_shuffle_epi8(lut, line));
+    }
+}
+
+/** Draws the 8 pixels of a sprite row over a line of shades. Transparent pixels and pixels
+ *  behind a non-white pixel are left unchanged.
+ *
+ * @param shades Shades of the line, starting at the first pixel of the sprite.
+ * @param colors Color numbers of the sprite row, in screen order.
+ * @param pallet Palette register value of the sprite.
+ * @param behind Whether the sprite is drawn behind non-white pixels.
+*/
+__attribute__((target("ssse3")))
+static void screen_merge_sprite_ssse3(uint8_t* shades, const uint8_t* colors, uint8_t pallet, bool behind) {
+    __m128i lut = _mm_setr_epi8(pallet & 0x3, (pallet >> 2) & 0x3, (pallet >> 4) & 0x3, (pallet >> 6) & 0x3,
+                                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i zero = _mm_setzero_si128();
+    __m128i sprite = _mm_loadl_epi64((const __m128i*) colors);
+    __m128i line = _mm_loadl_epi64((const __m128i*) shades);
+
+    __m128i hidden = _mm_cmpeq_epi8(sprite, zero);
+    if (behind) hidden = _mm_or_si128(hidden, _mm_xor_si128(_mm_cmpeq_epi8(line, zero), _mm_set1_epi8(-1)));
+
+    __m128i merged = _mm_or_si128(_mm_and_si128(hidden, line),
+                                  _mm_andnot_si128(hidden, _mm_shuffle_epi8(lut, sprite)));
+    _mm_storel_epi64((__m128i*) shades, merged);
+}
+
+/** Expands a line of shades into RGB888 pixels, 16 pixels at a time.
+ *
+ * @param shades Shades of the line.
+ * @param output Output holding the color of each shade.
+ * @param rgb Frame buffer line to write to.
+*/
+__attribute__((target("ssse3")))
+static void screen_write_rgb888_ssse3(const uint8_t* shades, const FrameOutput* output, uint8_t* rgb) {
+    // Entry 4*channel + shade holds the value of a channel for a shade.
+    const uint8_t (*pixels)[4] = output->pixels;
+    __m128i lut = _mm_setr_epi8((char) pixels[0][0], (char) pixels[1][0], (char) pixels[2][0], (char) pixels[3][0],
+                                (char) pixels[0][1], (char) pixels[1][1], (char) pixels[2][1], (char) pixels[3][1],
+                                (char) pixels[0][2], (char) pixels[1][2], (char) pixels[2][2], (char) pixels[3][2],
+                                0, 0, 0, 0);
+    __m128i spread0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    __m128i spread1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    __m128i spread2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    __m128i channel0 = _mm_setr_epi8(0, 4, 8, 0, 4, 8, 0, 4, 8, 0, 4, 8, 0, 4, 8, 0);
+    __m128i channel1 = _mm_setr_epi8(4, 8, 0, 4, 8, 0, 4, 8, 0, 4, 8, 0, 4, 8, 0, 4);
+    __m128i channel2 = _mm_setr_epi8(8, 0, 4, 8, 0, 4, 8, 0, 4, 8, 0, 4, 8, 0, 4, 8);
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x += 16) {
+        __m128i line = _mm_loadu_si128((const __m128i*) (shades + x));
+        __m128i out0 = _mm_add_epi8(_mm_shuffle_epi8(line, spread0), channel0);
+        __m128i out1 = _mm_add_epi8(_mm_shuffle_epi8(line, spread1), channel1);
+        __m128i out2 = _mm_add_epi8(_mm_shuffle_epi8(line, spread2), channel2);
+        _mm_storeu_si128((__m128i*) (rgb + 3*x), _mm_shuffle_epi8(lut, out0));
+        _mm_storeu_si128((__m128i*) (rgb + 3*x + 16), _mm_shuffle_epi8(lut, out1));
+        _mm_storeu_si128((__m128i*) (rgb + 3*x + 32), _mm_shuffle_epi8(lut, out2));
+    }
+}
+
+/** Maps a line of shades to single byte pixels, 16 pixels at a time.
+ *
+ * @param shades Shades of the line.
+ * @param output Output holding the value of each shade.
+ * @param pixels Frame buffer line to write to.
+*/
+__attribute__((target("ssse3")))
+static void screen_write_gray8_ssse3(const uint8_t* shades, const FrameOutput* output, uint8_t* pixels) {
+    __m128i lut = _mm_setr_epi8((char) output->pixels[0][0], (char) output->pixels[1][0],
+                                (char) output->pixels[2][0], (char) output->pixels[3][0],
+                                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x += 16) {
+        __m128i line = _mm_loadu_si128((const __m128i*) (shades + x));
+        _mm_storeu_si128((__m128i*) (pixels + x), _mm_shuffle_epi8(lut, line));
+    }
+}
+
+const ScreenCompositor screen_compositor_ssse3 = {
+    screen_map_pallet_ssse3, screen_merge_sprite_ssse3, screen_write_rgb888_ssse3, screen_write_gray8_ssse3
+};
+
+#endif  // SCREEN_SSSE3
+
+const ScreenCompositor* screen_compositor(void) {
+    // Gameboys drawn on several threads may all choose it at once. They choose the same one,
+    // so relaxed ordering is enough.
+    static _Atomic(const ScreenCompositor*) chosen = NULL;
+    const ScreenCompositor* compositor = atomic_load_explicit(&chosen, memory_order_relaxed);
+    if (!compositor) {
+        compositor = &screen_compositor_scalar;
+#ifdef SCREEN_SSSE3
+        if (__builtin_cpu_supports("ssse3")) compositor = &screen_compositor_ssse3;
+#endif
+        atomic_store_explicit(&chosen, compositor, memory_order_relaxed);
+    }
+    return compositor;
+}
+
+/** Writes a line of shades to the frame buffer in the output's pixel format.
+ *
+ * @param shades Shades of the line.
+ * @param output Pixel format and the pixel written for each shade.
+ * @param line Frame buffer line to write to.
+*/
+static void screen_write_line(const uint8_t* shades, const FrameOutput* output, uint8_t* line) {
+    switch (output->format) {
+        case FRAME_RGB888:
+            screen_compositor()->write_rgb888(shades, output, line);
+            break;
+        case FRAME_SHADE:
+            memcpy(line, shades, SCREEN_WIDTH);
+            break;
+        case FRAME_GRAY8:
+            screen_compositor()->write_gray8(shades, output, line);
+            break;
+        case FRAME_RGB565:
+            for (uint8_t x = 0; x < SCREEN_WIDTH; x++) memcpy(line + 2*x, output->pixels[shades[x]], 2);
+            break;
+        case FRAME_RGBA32:
+            for (uint8_t x = 0; x < SCREEN_WIDTH; x++) memcpy(line + 4*x, output->pixels[shades[x]], 4);
+            break;
+    }
+}
+
+void screen_update_tiles(uint8_t* gb_memory, TileCache* cache, uint8_t* shades) {
+    uint16_t background_memory = 0;
+    bool is_unsigned = true;
+    bool is_using_window = false;
+    uint8_t scroll_y = gb_memory[0xFF42];
+    uint8_t scroll_x = gb_memory[0xFF43];
+    uint8_t window_y = gb_memory[0xFF4A];
+    uint8_t window_x = gb_memory[0xFF4B] - 7;
+
+    uint8_t lcd_control = gb_memory[0xFF40];
+    uint8_t y = gb_memory[0xFF44];
+
+    if (lcd_control & (1 << 5)) {
+        if (window_y <= y) is_using_window = true;
+    }
+
+    if (!(lcd_control & (1 << 4))) is_unsigned = false;
+
+    if (!is_using_window) {
+        if (lcd_control & (1 << 3)) {
+            background_memory = 0x9C00;
+        } else {
+            background_memory = 0x9800;
+        }
+    } else {
+        if (lcd_control & (1 << 6)) {
+            background_memory = 0x9C00;
+        } else {
+            background_memory = 0x9800;
+        }
+    }
+
+    uint8_t y_pos = 0;
+
+    if (!is_using_window) {
+        y_pos = scroll_y + y;
+    } else {
+        y_pos = y - window_y;
+    }
+
+    uint16_t tile_row = ((y_pos / 8)) * 32;  // Base row index of the tile the scan line is on.
+    uint8_t line = y_pos % 8;
+
+    // Copy the color numbers of the line a tile row at a time.
+    uint8_t colors[160];
+    uint8_t x = 0;
+    while (x < 160) {
+        uint8_t x_pos;
+        uint8_t count;
+        if (is_using_window && x >= window_x) {
+            x_pos = x - window_x;
+            count = 8 - (x_pos % 8);
+        } else {
+            x_pos = x + scroll_x;
+            count = 8 - (x_pos % 8);
+            if (is_using_window && window_x - x < count) count = window_x - x;
+        }
+        if (160 - x < count) count = 160 - x;
+
+        uint8_t tile_num = gb_memory[background_memory + tile_row + x_pos/8];
+        uint16_t tile = is_unsigned ? tile_num : 256 + (int8_t) tile_num;
+        memcpy(colors + x, &cache->tiles[tile][line][x_pos % 8], count);
+        x += count;
+    }
+
+    screen_compositor()->map_pallet(colors, gb_memory[0xFF47], shades);
+}
+
+
+void screen_update_sprites(uint8_t* gb_memory, TileCache* cache, uint8_t* shades) {
+    uint8_t lcd_control = gb_memory[0xFF40];
+    uint8_t sprite_height = 8;
+
+    if (lcd_control & (1 << 2)) sprite_height = 16;
+
+    uint8_t scanline_pos = gb_memory[0xFF44];
+
+    for (uint8_t sprite_num = 0; sprite_num < 40; sprite_num++) {
+        uint8_t i = sprite_num*4;
+        uint8_t y_pos = gb_memory[0xFE00+i] - 16;
+        uint8_t x_pos = gb_memory[0xFE00+i+1] - 8;
+        uint8_t tile_location = gb_memory[0xFE00+i+2];
+        uint8_t attributes = gb_memory[0xFE00+i+3];
+
+        if (scanline_pos >= y_pos && scanline_pos < y_pos+sprite_height) {
+            uint8_t sprite_line = scanline_pos - y_pos;
+
+            if (attributes & (1 << 6)) {
+                sprite_line = sprite_height - sprite_line;
+            }
+
+            // Rows past the end of the tile continue into the following tiles.
+            uint8_t* row = cache->tiles[tile_location + sprite_line/8][sprite_line % 8];
+            uint8_t colors[8];
+            for (uint8_t col = 0; col < 8; col++) {
+                colors[col] = row[(attributes & (1 << 5)) ? 7 - col : col];
+            }
+
+            uint8_t pallet = gb_memory[attributes & (1 << 4) ? 0xFF49 : 0xFF48];
+
+            // Handle sprite priority. Bit of a hack for now.
+            // TODO(mct): Do this properly.
+            bool behind = attributes & (1 << 7);
+
+            if (x_pos <= SCREEN_WIDTH - 8) {
+                screen_compositor()->merge_sprite(shades + x_pos, colors, pallet, behind);
+                continue;
+            }
+
+            // Sprite is partly off screen, pixel positions wrap around at 256.
+            for (uint8_t col = 0; col < 8; col++) {
+                uint8_t x = x_pos + col;
+                if (x >= SCREEN_WIDTH || colors[col] == WHITE || (behind && shades[x] != WHITE)) continue;
+                shades[x] = (pallet >> (colors[col] * 2)) & 0x3;
+            }
+        }
+    }
+}
+
+
+void screen_update_status(uint8_t* gb_memory) {
+    uint8_t lcd_control = gb_memory[0xFF40];
+
+    if (!(lcd_control & (1 << 7))) {
+        gb_memory[0xFF44] = 0;
+        gb_memory[0xFF41] &= 0xFC;
+        gb_memory[0xFF41] |= 0x01;
+        return;
+    }
+
+    uint8_t current_mode = gb_memory[0xFF40] & 0x03;
+    uint8_t new_mode = 0;
+    bool generate_interupt = false;
+
+    if (gb_memory[0xFF44] >= 144) {
+        new_mode = 1;
+        gb_memory[0xFF41] &= 0xFC;
+        gb_memory[0xFF41] |= 0x01;
+        generate_interupt = gb_memory[0xFF41] & (1 << 4);
+    } else {
+        // TEMP
+        new_mode = 0;
+        gb_memory[0xFF41] &= ~(1 << 1);
+        gb_memory[0xFF41] &= ~0x01;
+        generate_interupt = gb_memory[0xFF41] & (1 << 3);
+    }
+    // TODO(mct): Other status stuff.
+
+    if (generate_interupt && (new_mode != current_mode)) {
+        gb_memory[0xFF0F] |= (1 << 1);
+    }
+
+    // Check conincidence flag
+    if (gb_memory[0xFF44] == gb_memory[0xFF45]) {
+        gb_memory[0xFF41] |= (1 << 2);
+        if (gb_memory[0xFF41] & (1 << 6)) {
+            gb_memory[0xFF0F] |= (1 << 1);
+        }
+        // gb_memory[0xFF0F] |= (1 << 1);
+    } else {
+        gb_memory[0xFF41] &= ~(1 << 2);
+    }
+}
+
+
+void screen_scanline_update(uint8_t* gb_memory, TileCache* cache, const FrameOutput* output,
+                            uint8_t* frame_buffer) {
+    screen_update_status(gb_memory);
+
+    uint8_t lcd_control = gb_memory[0xFF40];
+
+    // If LCD is disabled then we return.
+    if (!(lcd_control & (1 << 7))) {
+        return;
+    }
+
+    uint8_t y = gb_memory[0xFF44];
+    if (y < SCREEN_HEIGHT && frame_buffer) {
+        uint8_t* shades = cache->shades[y];
+
+        if (cache->any_dirty) screen_tile_cache_update(gb_memory, cache);
+        if (lcd_control & 0x01) {
+            screen_update_tiles(gb_memory, cache, shades);
+        }
+        // Otherwise the background is not drawn and sprites are drawn over the previous line.
+        if ((lcd_control >> 1) & 0x01) screen_update_sprites(gb_memory, cache, shades);
+
+        if (lcd_control & 0x03) {
+            screen_write_line(shades, output, frame_buffer + y*SCREEN_WIDTH*output->bytes_per_pixel);
+        }
+    }
+
+    gb_memory[0xFF44] = (gb_memory[0xFF44] + 1) % 154;
+
+    // V-blank interupt.
+    if (gb_memory[0xFF44] == 145) gb_memory[0xFF0F] |= 0x01;
+
+
 }
\ No newline at end of file
@@ -1,8 +1,121 @@
-#ifndef SRC_SCREEN_H_
-#define SRC_SCREEN_H_
-
-#include <stdint.h>
-
-void screen_scanline_update(uint8_t* gb_memory, uint8_t* frame_buffer);
-
+#ifndef SRC_SCREEN_H_
+#define SRC_SCREEN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCREEN_WIDTH 160
+#define SCREEN_HEIGHT 144
+#define SCREEN_FRAME_BYTES (SCREEN_WIDTH*SCREEN_HEIGHT*3)   // RGB888 frame buffer.
+
+// Pixel formats frames can be written in.
+enum FrameFormat {
+    FRAME_RGB888,   // 3 bytes per pixel, the default.
+    FRAME_SHADE,    // 1 byte per pixel holding the 2 bit shade, 0 is white and 3 is black.
+    FRAME_GRAY8,    // 1 byte per pixel holding the luma of the palette color.
+    FRAME_RGB565,   // 2 bytes per pixel in native byte order.
+    FRAME_RGBA32    // 4 bytes per pixel, stored R, G, B, A.
+};
+
+/** Pixel format frames are written in and the pixel written for each shade. */
+typedef struct frame_output_t {
+    enum FrameFormat format;
+    uint8_t bytes_per_pixel;
+    uint8_t pixels[4][4];   // Bytes written for each shade, in memory order.
+} FrameOutput;
+
+/** Sets up the output of frames in a pixel format.
+ *
+ * @param output FrameOutput to set up.
+ * @param format Pixel format to write.
+ * @param pallet Color of each shade as 0xRRGGBB, or NULL for the default grays. Not used by
+ *               FRAME_SHADE.
+*/
+void screen_frame_output_init(FrameOutput* output, enum FrameFormat format, const uint32_t* pallet);
+
+/** Gets the size of a frame in a pixel format.
+ *
+ * @param format Pixel format of the frame.
+ * @return Size of the frame in bytes.
+*/
+uint32_t screen_frame_bytes(enum FrameFormat format);
+
+// The SSSE3 compositor is built on x86 with GCC or Clang unless SCREEN_NO_SIMD is defined, and
+// is used if the cpu supports SSSE3.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(SCREEN_NO_SIMD)
+#define SCREEN_SSSE3
+#endif
+
+/** Functions that turn the color numbers of a scanline into pixels. Every compositor writes
+ *  exactly the same bytes.
+*/
+typedef struct screen_compositor_t {
+    // Maps a line of color numbers to shades through a palette register value.
+    void (*map_pallet)(const uint8_t* colors, uint8_t pallet, uint8_t* shades);
+    // Draws the 8 color numbers of a sprite row over shades, skipping transparent pixels and,
+    // if behind is set, pixels over non-white shades.
+    void (*merge_sprite)(uint8_t* shades, const uint8_t* colors, uint8_t pallet, bool behind);
+    // Write a line of shades to a frame buffer line in FRAME_RGB888 and FRAME_GRAY8.
+    void (*write_rgb888)(const uint8_t* shades, const FrameOutput* output, uint8_t* rgb);
+    void (*write_gray8)(const uint8_t* shades, const FrameOutput* output, uint8_t* pixels);
+} ScreenCompositor;
+
+extern const ScreenCompositor screen_compositor_scalar;
+#ifdef SCREEN_SSSE3
+extern const ScreenCompositor screen_compositor_ssse3;   // Only call if the cpu supports SSSE3.
+#endif
+
+/** Gets the fastest compositor the cpu supports.
+ *
+ * @return The compositor.
+*/
+const ScreenCompositor* screen_compositor(void);
+
+#define TILE_COUNT 384   // Tiles in VRAM between 0x8000 and 0x97FF.
+
+/** Tiles of VRAM decoded to one color number per pixel. Tiles are decoded again when the
+ *  VRAM they are stored in is written to.
+*/
+typedef struct tile_cache_t {
+    uint8_t tiles[TILE_COUNT][8][8];    // Color numbers, indexed by tile, row then column.
+    uint8_t dirty[TILE_COUNT/8];        // One bit per tile that needs to be decoded again.
+    uint8_t any_dirty;
+
+    // Shades of the last frame drawn. Sprites are drawn over these when the background is off.
+    uint8_t shades[SCREEN_HEIGHT][SCREEN_WIDTH];
+} TileCache;
+
+/** Allocates and creates a tile cache with every tile marked as needing to be decoded.
+ *
+ * @return A pointer to the TileCache created.
+*/
+TileCache* screen_tile_cache_create(void);
+
+/** Marks every tile as needing to be decoded, e.g. after VRAM was replaced.
+ *
+ * @param cache TileCache to operate on.
+*/
+void screen_tile_cache_invalidate(TileCache* cache);
+
+/** Marks the tile stored at a VRAM address as needing to be decoded.
+ *
+ * @param cache TileCache to operate on.
+ * @param address Address between 0x8000 and 0x97FF that was written to.
+*/
+static inline void screen_tile_cache_mark(TileCache* cache, uint16_t address) {
+    uint16_t tile = (address - 0x8000) >> 4;
+    cache->dirty[tile >> 3] |= 1 << (tile & 0x7);
+    cache->any_dirty = 1;
+}
+
+/** Draws the current scanline and advances LY, updating STAT and raising the LCD interrupts.
+ *
+ * @param gb_memory Memory of the gameboy.
+ * @param cache TileCache of the gameboy.
+ * @param output Pixel format to draw in.
+ * @param frame_buffer Frame buffer to draw to, or NULL to only update the LCD registers.
+*/
+void screen_scanline_update(uint8_t* gb_memory, TileCache* cache, const FrameOutput* output,
+                            uint8_t* frame_buffer);
+
 #endif  // SRC_SCREEN_H_
\ No newline at end of file
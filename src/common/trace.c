@@ -0,0 +1,69 @@
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Number of records copied out of the ring buffer at a time by trace_drain.
+#define TRACE_DRAIN_CHUNK 4096
+
+
+TraceBuffer* trace_create(uint8_t capacity_log2) {
+    TraceBuffer* trace = malloc(sizeof(TraceBuffer));
+    trace->records = calloc((size_t) 1 << capacity_log2, sizeof(TraceRecord));
+    trace->mask = (1u << capacity_log2) - 1;
+    atomic_init(&trace->head, 0);
+    trace->tail = 0;
+    trace->dropped = 0;
+    return trace;
+}
+
+void trace_destroy(TraceBuffer* trace) {
+    if (!trace) return;
+    free(trace->records);
+    free(trace);
+}
+
+void trace_write_header(FILE* fp) {
+    TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord)};
+    fwrite(&header, sizeof(TraceHeader), 1, fp);
+}
+
+uint64_t trace_drain(TraceBuffer* trace, FILE* fp) {
+    static _Thread_local TraceRecord chunk[TRACE_DRAIN_CHUNK];
+    uint64_t capacity = (uint64_t) trace->mask + 1;
+    uint64_t written = 0;
+
+    // Record head is being written over record head - capacity, so only the records from
+    // head + 1 - capacity on are intact.
+    uint64_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    while (trace->tail < head) {
+        // Skip records that have already been overwritten.
+        if (head - trace->tail >= capacity) {
+            trace->dropped += head + 1 - capacity - trace->tail;
+            trace->tail = head + 1 - capacity;
+        }
+
+        uint64_t count = head - trace->tail;
+        if (count > TRACE_DRAIN_CHUNK) count = TRACE_DRAIN_CHUNK;
+        for (uint64_t i = 0; i < count; i++) {
+            chunk[i] = trace->records[(trace->tail + i) & trace->mask];
+        }
+
+        // The writer may have overwritten part of the chunk while it was copied. The copies
+        // must be done before head is loaded again.
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t new_head = atomic_load_explicit(&trace->head, memory_order_acquire);
+        uint64_t valid_from = new_head + 1 > capacity ? new_head + 1 - capacity : 0;
+        uint64_t skip = valid_from > trace->tail ? valid_from - trace->tail : 0;
+        if (skip > count) skip = count;
+
+        fwrite(chunk + skip, sizeof(TraceRecord), count - skip, fp);
+        written += count - skip;
+        trace->dropped += skip;
+        trace->tail += count;
+        head = new_head;
+    }
+    return written;
+}
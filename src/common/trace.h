@@ -0,0 +1,81 @@
+#ifndef SRC_COMMON_TRACE_H_
+#define SRC_COMMON_TRACE_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC 0x52544247  // "GBTR"
+#define TRACE_VERSION 1
+
+/** Binary record of one executed instruction. */
+typedef struct trace_record_t {
+    uint64_t cycle;         // Value of cycle_count before the instruction executed.
+    uint16_t pc;
+    uint16_t bank;          // Cartridge ROM bank mapped at 0x4000-0x7FFF.
+    uint8_t opcode;
+    uint8_t operands[2];    // Bytes following the opcode, used by the decoder.
+    uint8_t padding;
+} TraceRecord;
+
+/** Header at the start of a trace file, followed by TraceRecords. */
+typedef struct trace_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+} TraceHeader;
+
+/** Ring buffer of trace records with a single writer, the emulation thread, and a single
+ *  reader that drains it. When the reader falls behind the oldest records are overwritten.
+*/
+typedef struct trace_buffer_t {
+    TraceRecord* records;
+    uint32_t mask;              // Capacity - 1, the capacity is a power of 2.
+    atomic_uint_fast64_t head;  // Number of records ever written.
+    uint64_t tail;              // Number of records the reader has consumed or skipped.
+    uint64_t dropped;           // Number of records overwritten before they were read.
+} TraceBuffer;
+
+/** Allocates and creates an empty trace buffer.
+ *
+ * @param capacity_log2 Log2 of the number of records the buffer holds.
+ * @return A pointer to the TraceBuffer created.
+*/
+TraceBuffer* trace_create(uint8_t capacity_log2);
+
+/** Frees all memory used by the trace buffer.
+ *
+ * @param trace TraceBuffer to destroy, may be NULL.
+*/
+void trace_destroy(TraceBuffer* trace);
+
+/** Writes the header of a trace file.
+ *
+ * @param fp File to write to.
+*/
+void trace_write_header(FILE* fp);
+
+/** Writes all records that have not been read yet to a file. May be called from a
+ *  different thread than the one writing records.
+ *
+ * @param trace TraceBuffer to read from.
+ * @param fp File to write to.
+ * @return The number of records written.
+*/
+uint64_t trace_drain(TraceBuffer* trace, FILE* fp);
+
+/** Appends a record to the trace buffer.
+ *
+ * @param trace TraceBuffer to write to.
+ * @param record Record to append.
+*/
+static inline void trace_push(TraceBuffer* trace, const TraceRecord* record) {
+    uint64_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    // The record must not be written before head was published by the last push, so a reader
+    // that copied part of it finds head moved on, see trace_drain.
+    atomic_thread_fence(memory_order_release);
+    trace->records[head & trace->mask] = *record;
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+#endif  // SRC_COMMON_TRACE_H_
@@ -0,0 +1,324 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gameboy.h"
+#include "gameboy_movie.h"
+#include "gameboy_state.h"
+#include "profile.h"
+#include "screen.h"
+#include "trace.h"
+
+// Log2 of the number of records kept between two drains of the trace buffer.
+#define TRACE_CAPACITY_LOG2 20
+
+// Frames between the state checkpoints of recorded movies.
+#define MOVIE_CHECKPOINT_INTERVAL 60
+
+// Number of the hottest locations listed in a profile report.
+#define PROFILE_REPORT_LOCATIONS 100
+
+/** Prints how to use the program.
+ *
+ * @param program Name the program was run as.
+*/
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [-n frames] [-s skip] [-a frames] [-b bootstrap] [-f format] [-o frame] [-t trace.bin]\n"
+            "       [-p report] [-g stacks] [-r movie | -m movie] rom\n"
+            "  -n frames     Number of frames to run (default 3600).\n"
+            "  -s skip       Draw only every skip-th frame and the last one (default 1).\n"
+            "  -a frames     Number of frames to run ahead of each frame (default 0).\n"
+            "  -b bootstrap  Bootstrap ROM to run first, skipped if not given.\n"
+            "  -f format     Frame format: rgb888 (default), shade, gray8, rgb565 or rgba32.\n"
+            "  -o frame      Write the last frame, as a PPM image for rgb888, a PGM image for\n"
+            "                gray8 and raw pixels otherwise.\n"
+            "  -t trace.bin  Write a binary instruction trace, needs a TRACE=1 build.\n"
+            "  -p report     Write the opcodes and locations that took the most cycles, needs a\n"
+            "                PROFILE=1 build.\n"
+            "  -g stacks     Write the cycles of each call stack for flamegraph.pl, needs a\n"
+            "                PROFILE=1 build.\n"
+            "  -r movie      Record the run to a movie.\n"
+            "  -m movie      Replay a movie without drawing and check its checkpoints, instead of\n"
+            "                running for a number of frames.\n",
+            program);
+}
+
+// Name of each frame format on the command line.
+static const char* format_names[] = {
+    [FRAME_RGB888] = "rgb888",
+    [FRAME_SHADE] = "shade",
+    [FRAME_GRAY8] = "gray8",
+    [FRAME_RGB565] = "rgb565",
+    [FRAME_RGBA32] = "rgba32"
+};
+
+/** Looks up a frame format by name.
+ *
+ * @param name Name of the format.
+ * @param format Set to the format found.
+ * @return 0 on success, 1 if there is no format with that name.
+*/
+static int parse_format(const char* name, enum FrameFormat* format) {
+    for (uint32_t i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++) {
+        if (!strcmp(name, format_names[i])) {
+            *format = i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/** Writes a frame to a file. RGB888 frames are written as a binary PPM image, GRAY8 frames as a
+ *  binary PGM image and other formats as raw pixels.
+ *
+ * @param path Path of the file.
+ * @param frame_buffer Frame to write.
+ * @param format Pixel format of the frame.
+ * @return 0 on success, 1 otherwise.
+*/
+static int write_frame(const char* path, const uint8_t* frame_buffer, enum FrameFormat format) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) return 1;
+    if (format == FRAME_RGB888) fprintf(fp, "P6\n%d %d\n255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (format == FRAME_GRAY8) fprintf(fp, "P5\n%d %d\n255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+    fwrite(frame_buffer, 1, screen_frame_bytes(format), fp);
+    fclose(fp);
+    return 0;
+}
+
+/** Gets the current time of a monotonic clock.
+ *
+ * @return Time in nanoseconds.
+*/
+static uint64_t time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/** Writes the profile of a Gameboy to the files asked for.
+ *
+ * @param profile Profile to write.
+ * @param report_path Path of the report, or NULL for none.
+ * @param folded_path Path of the folded call stacks, or NULL for none.
+ * @return 0 on success, 1 if a file could not be written.
+*/
+static int write_profile(Profile* profile, const char* report_path, const char* folded_path) {
+    int failed = 0;
+    if (report_path) {
+        FILE* fp = fopen(report_path, "w");
+        if (fp) {
+            profile_write_report(profile, fp, PROFILE_REPORT_LOCATIONS);
+            if (fclose(fp)) fp = NULL;
+        }
+        if (!fp) {
+            fprintf(stderr, "Could not write %s\n", report_path);
+            failed = 1;
+        }
+    }
+    if (folded_path) {
+        FILE* fp = fopen(folded_path, "w");
+        if (fp) {
+            profile_write_folded(profile, fp);
+            if (fclose(fp)) fp = NULL;
+        }
+        if (!fp) {
+            fprintf(stderr, "Could not write %s\n", folded_path);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = 3600;
+    uint32_t skip = 1;
+    uint32_t run_ahead = 0;
+    const char* bootstrap_path = NULL;
+    const char* output_path = NULL;
+    const char* trace_path = NULL;
+    const char* report_path = NULL;
+    const char* folded_path = NULL;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    enum FrameFormat format = FRAME_RGB888;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:a:b:f:o:t:p:g:r:m:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                frames = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                skip = strtoul(optarg, NULL, 10);
+                if (skip == 0) skip = 1;
+                break;
+            case 'a':
+                run_ahead = strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                bootstrap_path = optarg;
+                break;
+            case 'f':
+                if (parse_format(optarg, &format)) {
+                    fprintf(stderr, "Unknown frame format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'p':
+                report_path = optarg;
+                break;
+            case 'g':
+                folded_path = optarg;
+                break;
+            case 'r':
+                record_path = optarg;
+                break;
+            case 'm':
+                replay_path = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (record_path && run_ahead) {
+        fprintf(stderr, "Movies can not be recorded with run-ahead\n");
+        return 1;
+    }
+
+    Gameboy* gb = gameboy_create();
+    if (gameboy_map_rom(gb, argv[optind])) return 1;
+    if (bootstrap_path) {
+        FILE* fp = fopen(bootstrap_path, "rb");
+        if (!fp) {
+            fprintf(stderr, "Could not open bootstrap ROM %s\n", bootstrap_path);
+            return 1;
+        }
+        gameboy_load_bootstrap(gb, fp);
+        fclose(fp);
+    } else {
+        gameboy_skip_bootstrap(gb);
+    }
+    gameboy_set_frame_format(gb, format, NULL);
+
+    FILE* trace_fp = NULL;
+    if (trace_path) {
+#ifndef GAMEBOY_TRACE
+        fprintf(stderr, "Tracing is not available, rebuild with TRACE=1\n");
+        return 1;
+#endif
+        trace_fp = fopen(trace_path, "wb");
+        if (!trace_fp) {
+            fprintf(stderr, "Could not open %s\n", trace_path);
+            return 1;
+        }
+        trace_write_header(trace_fp);
+        gb->trace = trace_create(TRACE_CAPACITY_LOG2);
+    }
+
+    if (report_path || folded_path) {
+#ifndef GAMEBOY_PROFILE
+        fprintf(stderr, "Profiling is not available, rebuild with PROFILE=1\n");
+        return 1;
+#endif
+        gb->profile = profile_create();
+    }
+
+    if (replay_path) {
+        GameboyMovie* movie = gameboy_movie_load(replay_path);
+        if (!movie) {
+            fprintf(stderr, "Could not read movie %s\n", replay_path);
+            return 1;
+        }
+
+        uint32_t failed_frame;
+        uint64_t start = time_ns();
+        int failed = gameboy_movie_replay(movie, gb, &failed_frame);
+        double seconds = (time_ns() - start) / 1e9;
+
+        printf("frames:        %u\n", movie->frame_count);
+        printf("time:          %.3f s\n", seconds);
+        printf("frames/sec:    %.1f\n", movie->frame_count / seconds);
+        if (failed) {
+            printf("replay:        failed after %u frames\n", failed_frame);
+        } else {
+            printf("replay:        ok\n");
+        }
+        if (gb->profile && write_profile(gb->profile, report_path, folded_path)) failed = 1;
+
+        gameboy_movie_destroy(movie);
+        gameboy_destroy(gb);
+        return failed;
+    }
+
+    // Runs started without a bootstrap ROM are at power on.
+    GameboyMovie* movie = NULL;
+    if (record_path) movie = gameboy_movie_create(gb, !bootstrap_path, MOVIE_CHECKPOINT_INTERVAL);
+
+    static uint8_t frame_buffer[SCREEN_WIDTH*SCREEN_HEIGHT*4];   // Large enough for any format.
+    GameboySnapshot* snapshot = gameboy_snapshot_create(gb);
+
+    // Run as fast as possible, with no pacing and all buttons released.
+    uint64_t start = time_ns();
+    for (uint32_t i = 0; i < frames; i++) {
+        bool draw = (i + 1) % skip == 0 || i + 1 == frames;
+        if (movie) {
+            gameboy_movie_record_frame(movie, gb, 0xFF, draw ? frame_buffer : NULL);
+        } else {
+            gameboy_run_ahead(gb, snapshot, 0xFF, run_ahead, draw ? frame_buffer : NULL);
+        }
+        if (trace_fp) trace_drain(gb->trace, trace_fp);
+    }
+    uint64_t elapsed = time_ns() - start;
+
+    double seconds = elapsed / 1e9;
+    printf("frames:        %u\n", frames);
+    printf("drawn:         %u\n", frames / skip + (frames % skip != 0));
+    printf("instructions:  %llu\n", (unsigned long long) gb->instruction_count);
+    printf("cycles:        %llu\n", (unsigned long long) gb->cycle_count);
+    printf("time:          %.3f s\n", seconds);
+    printf("frames/sec:    %.1f\n", frames / seconds);
+    printf("emulated MHz:  %.2f\n", gb->cycle_count / seconds / 1e6);
+    printf("ns/instr:      %.2f\n", gb->instruction_count ? (double) elapsed / gb->instruction_count : 0.0);
+    printf("state hash:    %016llx\n", (unsigned long long) gameboy_state_hash(gb));
+
+    if (output_path && write_frame(output_path, frame_buffer, format)) {
+        fprintf(stderr, "Could not write %s\n", output_path);
+    }
+
+    if (gb->profile) write_profile(gb->profile, report_path, folded_path);
+
+    if (trace_fp) {
+        if (gb->trace->dropped) {
+            fprintf(stderr, "%llu trace records were dropped\n", (unsigned long long) gb->trace->dropped);
+        }
+        fclose(trace_fp);
+    }
+
+    if (movie) {
+        if (gameboy_movie_save(movie, record_path)) fprintf(stderr, "Could not write %s\n", record_path);
+        gameboy_movie_destroy(movie);
+    }
+
+    gameboy_snapshot_destroy(snapshot);
+    gameboy_destroy(gb);
+    return 0;
+}
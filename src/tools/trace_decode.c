@@ -0,0 +1,38 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "disassembler.h"
+#include "trace.h"
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s trace.bin\n", argv[0]);
+        return 1;
+    }
+
+    FILE* fp = fopen(argv[1], "rb");
+    if (!fp) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    TraceHeader header;
+    if (fread(&header, sizeof(TraceHeader), 1, fp) != 1 || header.magic != TRACE_MAGIC ||
+            header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "%s is not a version %d trace\n", argv[1], TRACE_VERSION);
+        fclose(fp);
+        return 1;
+    }
+
+    TraceRecord record;
+    char mnemonic[64];
+    while (fread(&record, sizeof(TraceRecord), 1, fp) == 1) {
+        const uint8_t bytes[3] = {record.opcode, record.operands[0], record.operands[1]};
+        disassemble_instruction(record.pc, bytes, mnemonic, sizeof(mnemonic));
+        printf("%12llu  %.3X:%.4X  %.2X  %s\n", (unsigned long long) record.cycle, record.bank,
+               record.pc, record.opcode, mnemonic);
+    }
+
+    fclose(fp);
+    return 0;
+}
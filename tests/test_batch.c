@@ -0,0 +1,54 @@
+#define _POSIX_C_SOURCE 200809L
+
+// Checks that a batch runs every Gameboy like a single one, and that a batch that can not load
+// its ROM is not created.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gameboy.h"
+#include "gameboy_batch.h"
+#include "test_util.h"
+
+#define BATCH_COUNT 6
+#define BATCH_FRAMES 10
+
+int main(void) {
+    char path[] = "/tmp/gbc-test-batch-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    uint8_t* rom = test_create_rom(3);
+    CHECK(write(fd, rom, TEST_ROM_SIZE) == TEST_ROM_SIZE);
+    close(fd);
+
+    CHECK(gameboy_batch_create(BATCH_COUNT, "/nonexistent/rom.gb", NULL, 2) == NULL);
+    CHECK(gameboy_batch_create(BATCH_COUNT, path, "/nonexistent/bootstrap.bin", 2) == NULL);
+
+    GameboyBatch* batch = gameboy_batch_create(BATCH_COUNT, path, NULL, 3);
+    CHECK(batch != NULL);
+    uint8_t buttons[BATCH_COUNT];
+    for (uint32_t i = 0; i < BATCH_COUNT; i++) buttons[i] = 0xFF ^ (1 << i);
+    gameboy_batch_step(batch, buttons, BATCH_FRAMES);
+
+    // Each instance matches a Gameboy run on its own with the same buttons.
+    static uint8_t frame[SCREEN_FRAME_BYTES];
+    for (uint32_t i = 0; i < BATCH_COUNT; i++) {
+        Gameboy* gb = gameboy_create();
+        test_load_rom(gb, rom, TEST_ROM_SIZE);
+        gameboy_skip_bootstrap(gb);
+        for (uint32_t f = 1; f < BATCH_FRAMES; f++) gameboy_single_frame_update(gb, buttons[i], NULL);
+        gameboy_single_frame_update(gb, buttons[i], frame);
+
+        CHECK(memcmp(frame, batch->frames + i*batch->frame_bytes, SCREEN_FRAME_BYTES) == 0);
+        CHECK(gb->cycle_count == batch->gameboys[i]->cycle_count);
+        CHECK(gb->cpu->PC == batch->gameboys[i]->cpu->PC);
+        gameboy_destroy(gb);
+    }
+
+    gameboy_batch_destroy(batch);
+    free(rom);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,60 @@
+// Checks the mnemonics the disassembler writes, in particular the signed r8 operands.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "disassembler.h"
+#include "test_util.h"
+
+/** Checks the mnemonic and length of an instruction.
+ *
+ * @param pc Address of the instruction.
+ * @param opcode Opcode of the instruction.
+ * @param operand0 Byte after the opcode.
+ * @param operand1 Second byte after the opcode.
+ * @param expected Expected mnemonic.
+ * @param length Expected length of the instruction.
+*/
+static void check_instruction(uint16_t pc, uint8_t opcode, uint8_t operand0, uint8_t operand1,
+                              const char* expected, uint8_t length) {
+    const uint8_t bytes[3] = {opcode, operand0, operand1};
+    char mnemonic[64];
+    uint8_t decoded = disassemble_instruction(pc, bytes, mnemonic, sizeof(mnemonic));
+    if (strcmp(mnemonic, expected) || decoded != length) {
+        fprintf(stderr, "%.2X %.2X %.2X at %.4X: got \"%s\" (%u bytes), expected \"%s\" (%u bytes)\n",
+                opcode, operand0, operand1, pc, mnemonic, decoded, expected, length);
+    }
+    CHECK(!strcmp(mnemonic, expected) && decoded == length);
+}
+
+int main(void) {
+    // Relative jumps are written with their target, PC + 2 + r8.
+    check_instruction(0x0150, 0x20, 0xFE, 0x00, "JR NZ,$0150", 2);
+    check_instruction(0x1000, 0x18, 0x05, 0x00, "JR $1007", 2);
+    check_instruction(0x1000, 0x38, 0x80, 0x00, "JR C,$0F82", 2);
+    check_instruction(0xFFF0, 0x28, 0x7F, 0x00, "JR Z,$0071", 2);
+
+    // Other r8 operands are written signed.
+    check_instruction(0x0000, 0xF8, 0xFD, 0x00, "LD HL,SP-$03", 2);
+    check_instruction(0x0000, 0xF8, 0x05, 0x00, "LD HL,SP+$05", 2);
+    check_instruction(0x0000, 0xE8, 0x80, 0x00, "ADD SP,-$80", 2);
+    check_instruction(0x0000, 0xE8, 0x7F, 0x00, "ADD SP,$7F", 2);
+
+    // Unsigned operands, only as many bytes as the instruction has are read.
+    check_instruction(0x0000, 0x01, 0x34, 0x12, "LD BC,$1234", 3);
+    check_instruction(0x0000, 0xCD, 0x00, 0x40, "CALL $4000", 3);
+    check_instruction(0x0000, 0xE0, 0x44, 0x99, "LDH ($44),A", 2);
+    check_instruction(0x0000, 0x3E, 0x99, 0x12, "LD A,$99", 2);
+    check_instruction(0x0000, 0x00, 0x34, 0x12, "NOP", 1);
+    check_instruction(0x0000, 0xCB, 0x7C, 0x00, "BIT 7,H", 2);
+    check_instruction(0x0000, 0xD3, 0x00, 0x00, "???", 0);
+
+    // Every mnemonic has as many operand bytes as the instruction's length.
+    for (uint32_t opcode = 0; opcode < 0x100; opcode++) {
+        const char* name = instruction_names[opcode];
+        uint8_t operands = strstr(name, "16") ? 2 : (strstr(name, "8") && strncmp(name, "RST", 3)) ? 1 : 0;
+        if (opcode == 0xCB || opcode == 0x10) operands = 1;  // The CB opcode and STOP's 0x00.
+        if (instruction_lengths[opcode]) CHECK(instruction_lengths[opcode] == operands + 1);
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+// Runs random instruction sequences and prints the registers, a digest of memory and the cycle
+// count after every frame. The Makefile builds it once for each interpreter core and checks
+// that every build prints the same.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+#include "gameboy.h"
+#include "test_util.h"
+
+#define DISPATCH_SEEDS 32
+#define DISPATCH_FRAMES 20
+
+/** Gets the FNV-1a digest of a buffer.
+ *
+ * @param data Buffer to digest.
+ * @param size Size of the buffer in bytes.
+ * @return The digest.
+*/
+static uint64_t dispatch_digest(const uint8_t* data, uint32_t size) {
+    uint64_t digest = 0xCBF29CE484222325ull;
+    for (uint32_t i = 0; i < size; i++) {
+        digest ^= data[i];
+        digest *= 0x100000001B3ull;
+    }
+    return digest;
+}
+
+int main(void) {
+    static uint8_t frame_buffer[160*144*3];
+
+    for (uint32_t seed = 1; seed <= DISPATCH_SEEDS; seed++) {
+        Gameboy* gb = test_create_gameboy(seed);
+        uint8_t* state = malloc(gb->state_size);
+        uint32_t buttons = seed;
+
+        for (uint32_t frame = 0; frame < DISPATCH_FRAMES; frame++) {
+            gameboy_single_frame_update(gb, test_random(&buttons), frame_buffer);
+            gameboy_copy_state(gb, state);
+
+            printf("%2u %2u AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X PC=%04X IME=%u halted=%u "
+                   "cycles=%llu instructions=%llu memory=%016llx frame=%016llx\n",
+                   seed, frame, cpu_get_value_AF(gb->cpu), cpu_get_value_BC(gb->cpu),
+                   cpu_get_value_DE(gb->cpu), cpu_get_value_HL(gb->cpu), gb->cpu->SP, gb->cpu->PC,
+                   gb->int_master_enable, gb->halted, (unsigned long long) gb->cycle_count,
+                   (unsigned long long) gb->instruction_count,
+                   (unsigned long long) dispatch_digest(state, gb->state_size),
+                   (unsigned long long) dispatch_digest(frame_buffer, sizeof(frame_buffer)));
+        }
+
+        free(state);
+        gameboy_destroy(gb);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Forks Gameboys and checks that writes by either side of a fork never reach the other, and
+// that a forked Gameboy runs exactly as it would have without the fork.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+#include "memory.h"
+#include "test_util.h"
+
+#define FORK_SEEDS 8
+#define FORK_FRAMES 10
+
+/** Checks the state of a Gameboy is the same as a copy taken earlier.
+ *
+ * @param gb Gameboy to check.
+ * @param expected Copy of the state from gameboy_copy_state.
+*/
+static void fork_check_state(Gameboy* gb, const uint8_t* expected) {
+    uint8_t* state = malloc(gb->state_size);
+    gameboy_copy_state(gb, state);
+    CHECK(memcmp(state, expected, gb->state_size) == 0);
+    free(state);
+}
+
+int main(void) {
+    for (uint32_t seed = 1; seed <= FORK_SEEDS; seed++) {
+        Gameboy* reference = test_create_gameboy(seed);
+        Gameboy* parent = test_create_gameboy(seed);
+        uint8_t* state = malloc(parent->state_size);
+        uint32_t buttons = seed;
+
+        for (uint32_t frame = 0; frame < FORK_FRAMES; frame++) {
+            uint8_t frame_buttons = test_random(&buttons);
+            gameboy_single_frame_update(reference, frame_buttons, NULL);
+            gameboy_single_frame_update(parent, frame_buttons, NULL);
+        }
+
+        // Writing a page of work RAM and of cartridge RAM in the child leaves the parent's copy
+        // of the page unchanged.
+        Gameboy* child = gameboy_fork(parent);
+        gameboy_copy_state(parent, state);
+        uint8_t work_ram = memory_get8(parent, 0xC123);
+        uint8_t written_work_ram = ~work_ram;
+        memory_set8(child, 0xC123, written_work_ram);
+
+        // Cartridge RAM is enabled to write it, then disabled in the parent and the reference alike.
+        memory_set8(child, 0x0000, 0x0A);
+        memory_set8(parent, 0x0000, 0x0A);
+        uint8_t cartridge_ram = memory_get8(parent, 0xA456);
+        uint8_t written_cartridge_ram = ~cartridge_ram;
+        memory_set8(child, 0xA456, written_cartridge_ram);
+
+        CHECK(memory_get8(child, 0xC123) == written_work_ram);
+        CHECK(memory_get8(child, 0xA456) == written_cartridge_ram);
+        CHECK(memory_get8(parent, 0xC123) == work_ram);
+        CHECK(memory_get8(parent, 0xA456) == cartridge_ram);
+        memory_set8(parent, 0x0000, 0x00);
+        memory_set8(reference, 0x0000, 0x00);
+        fork_check_state(parent, state);
+
+        // Running the child does not change the parent, and a parent that writes every page
+        // again does not change the child.
+        for (uint32_t frame = 0; frame < FORK_FRAMES; frame++) {
+            gameboy_single_frame_update(child, test_random(&buttons), NULL);
+        }
+        fork_check_state(parent, state);
+
+        uint8_t* child_state = malloc(child->state_size);
+        gameboy_copy_state(child, child_state);
+        for (uint32_t frame = 0; frame < FORK_FRAMES; frame++) {
+            uint8_t frame_buttons = test_random(&buttons);
+            gameboy_single_frame_update(reference, frame_buttons, NULL);
+            gameboy_single_frame_update(parent, frame_buttons, NULL);
+        }
+        fork_check_state(child, child_state);
+
+        // The parent runs the same as a Gameboy that was never forked, even after the child is
+        // destroyed.
+        gameboy_copy_state(reference, state);
+        fork_check_state(parent, state);
+        gameboy_destroy(child);
+        gameboy_single_frame_update(reference, 0, NULL);
+        gameboy_single_frame_update(parent, 0, NULL);
+        gameboy_copy_state(reference, state);
+        fork_check_state(parent, state);
+        CHECK(parent->cycle_count == reference->cycle_count);
+        CHECK(parent->cpu->PC == reference->cpu->PC);
+
+        free(child_state);
+        free(state);
+        gameboy_destroy(parent);
+        gameboy_destroy(reference);
+    }
+
+    printf("test_fork: passed\n");
+    return 0;
+}
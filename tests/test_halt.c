@@ -0,0 +1,70 @@
+// Runs HALT with interrupts disabled, with and without an enabled interrupt pending, and checks
+// that the cpu halts or hits the HALT bug, reading the opcode after HALT twice.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+#include "gameboy.h"
+#include "test_util.h"
+
+/** Creates a Gameboy running HALT; LD A,0x14 followed by an endless loop, with interrupts
+ *  disabled and only the V-Blank interrupt enabled.
+ *
+ * @param pending Whether the V-Blank interrupt is already requested.
+ * @return A pointer to the Gameboy created.
+*/
+static Gameboy* halt_create_gameboy(uint8_t pending) {
+    static const uint8_t code[] = {
+        0x76,               // HALT
+        0x3E, 0x14,         // LD A,0x14
+        0x18, 0xFE,         // JR -2
+    };
+
+    uint8_t* rom = calloc(1, TEST_ROM_SIZE);
+    rom[0x100] = 0xC3;
+    rom[0x101] = TEST_CODE_START & 0xFF;
+    rom[0x102] = TEST_CODE_START >> 8;
+    rom[0x147] = 0x03;
+    rom[0x148] = 0x01;
+    rom[0x149] = 0x03;
+    for (uint32_t i = 0; i < sizeof(code); i++) rom[TEST_CODE_START + i] = code[i];
+
+    Gameboy* gb = gameboy_create();
+    test_load_rom(gb, rom, TEST_ROM_SIZE);
+    free(rom);
+    gameboy_skip_bootstrap(gb);
+
+    gb->int_master_enable = 0;
+    gb->memory[0xFFFF] = 0x01;
+    gb->memory[0xFF0F] = pending ? 0x01 : 0x00;
+    gb->cpu->A = 0x00;
+    gb->cpu->D = 0x00;
+    return gb;
+}
+
+int main(void) {
+    // The HALT bug. The opcode of LD A,0x14 is read again as its operand, then 0x14 runs as
+    // INC D.
+    Gameboy* gb = halt_create_gameboy(1);
+    gameboy_single_frame_update(gb, 0, NULL);
+    CHECK(gb->halted == 0);
+    CHECK(gb->cpu->A == 0x3E);
+    CHECK(gb->cpu->D == 0x01);
+    CHECK(gb->cpu->PC == TEST_CODE_START + 3);
+    gameboy_destroy(gb);
+
+    // Without an interrupt pending the cpu halts. The V-Blank interrupt requested during the
+    // frame wakes it, and LD A,0x14 runs normally.
+    gb = halt_create_gameboy(0);
+    gameboy_single_frame_update(gb, 0, NULL);
+    gameboy_single_frame_update(gb, 0, NULL);
+    CHECK(gb->halted == 0);
+    CHECK(gb->cpu->A == 0x14);
+    CHECK(gb->cpu->D == 0x00);
+    CHECK(gb->cpu->PC == TEST_CODE_START + 3);
+    gameboy_destroy(gb);
+
+    printf("test_halt: passed\n");
+    return 0;
+}
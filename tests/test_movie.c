@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+
+// Records movies, saves and loads them, and checks that they replay with every checkpoint
+// matching while movies that were tampered with or replayed on another ROM fail.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gameboy.h"
+#include "gameboy_movie.h"
+#include "test_util.h"
+
+#define MOVIE_SEEDS 4
+#define MOVIE_FRAMES 30
+#define MOVIE_CHECKPOINT_INTERVAL 5
+
+/** Records a movie of a Gameboy and writes it to a file.
+ *
+ * @param seed Seed of the Gameboy's ROM, memory and buttons.
+ * @param power_on Whether the movie starts at power on rather than from a stored state.
+ * @param path Path of the file.
+*/
+static void movie_record(uint32_t seed, uint8_t power_on, const char* path) {
+    Gameboy* gb;
+    if (power_on) {
+        uint8_t* rom = test_create_rom(seed);
+        gb = gameboy_create();
+        test_load_rom(gb, rom, TEST_ROM_SIZE);
+        free(rom);
+        gameboy_skip_bootstrap(gb);
+    } else {
+        gb = test_create_gameboy(seed);
+        gameboy_single_frame_update(gb, 0, NULL);
+    }
+
+    GameboyMovie* movie = gameboy_movie_create(gb, power_on, MOVIE_CHECKPOINT_INTERVAL);
+    uint32_t random = seed;
+    for (uint32_t frame = 0; frame < MOVIE_FRAMES; frame++) {
+        gameboy_movie_record_frame(movie, gb, test_random(&random), NULL);
+    }
+    CHECK(gameboy_movie_save(movie, path) == 0);
+    gameboy_movie_destroy(movie);
+    gameboy_destroy(gb);
+}
+
+/** Creates a Gameboy to replay a movie on.
+ *
+ * @param seed Seed of the Gameboy's ROM.
+ * @return A pointer to the Gameboy created, at power on.
+*/
+static Gameboy* movie_create_gameboy(uint32_t seed) {
+    uint8_t* rom = test_create_rom(seed);
+    Gameboy* gb = gameboy_create();
+    test_load_rom(gb, rom, TEST_ROM_SIZE);
+    free(rom);
+    gameboy_skip_bootstrap(gb);
+    return gb;
+}
+
+/** Replays a movie on a fresh Gameboy.
+ *
+ * @param movie GameboyMovie to replay.
+ * @param seed Seed of the Gameboy's ROM.
+ * @param failed_frame Set to the number of frames run when the replay failed.
+ * @return The result of gameboy_movie_replay.
+*/
+static int movie_replay(GameboyMovie* movie, uint32_t seed, uint32_t* failed_frame) {
+    Gameboy* gb = movie_create_gameboy(seed);
+    int result = gameboy_movie_replay(movie, gb, failed_frame);
+    gameboy_destroy(gb);
+    return result;
+}
+
+int main(void) {
+    char path[] = "/tmp/gbc-test-movie-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+
+    for (uint32_t seed = 1; seed <= MOVIE_SEEDS; seed++) {
+        for (uint8_t power_on = 0; power_on <= 1; power_on++) {
+            uint32_t failed_frame;
+            movie_record(seed, power_on, path);
+            GameboyMovie* movie = gameboy_movie_load(path);
+            CHECK(movie != NULL);
+            CHECK(movie->frame_count == MOVIE_FRAMES);
+            CHECK((movie->start_state == NULL) == power_on);
+
+            // Every checkpoint matches, however many times the movie is replayed.
+            CHECK(movie_replay(movie, seed, &failed_frame) == 0);
+            CHECK(failed_frame == 0);
+            CHECK(movie_replay(movie, seed, &failed_frame) == 0);
+
+            // Another ROM fails before any frame is run.
+            CHECK(movie_replay(movie, seed + MOVIE_SEEDS, &failed_frame) == 1);
+            CHECK(failed_frame == 0);
+
+            // A wrong checkpoint fails on the frame it was taken after.
+            movie->checkpoints[2] ^= 1;
+            CHECK(movie_replay(movie, seed, &failed_frame) == 1);
+            CHECK(failed_frame == 3*MOVIE_CHECKPOINT_INTERVAL);
+            movie->checkpoints[2] ^= 1;
+
+            // Other buttons make the replay diverge from the recording.
+            for (uint32_t frame = 0; frame < MOVIE_FRAMES; frame++) movie->buttons[frame] ^= 0xFF;
+            CHECK(movie_replay(movie, seed, &failed_frame) == 1);
+            CHECK(failed_frame > 0);
+            gameboy_movie_destroy(movie);
+        }
+
+        // A file that is not a movie, or is cut short, is not loaded.
+        FILE* fp = fopen(path, "r+b");
+        CHECK(fp != NULL);
+        fputc('X', fp);
+        fclose(fp);
+        CHECK(gameboy_movie_load(path) == NULL);
+
+        movie_record(seed, 1, path);
+        CHECK(truncate(path, 40) == 0);
+        CHECK(gameboy_movie_load(path) == NULL);
+    }
+
+    CHECK(gameboy_movie_load("/nonexistent/movie.gbm") == NULL);
+    unlink(path);
+    printf("test_movie: passed\n");
+    return 0;
+}
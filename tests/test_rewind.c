@@ -0,0 +1,111 @@
+// Records a run in a rewind history, steps back through it and checks the Gameboy is restored
+// byte for byte to the state saved at each snapshot, then that it runs on from there the same.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+#include "gameboy_rewind.h"
+#include "gameboy_state.h"
+#include "test_util.h"
+
+#define REWIND_SEEDS 4
+#define REWIND_FRAMES 24
+
+/** Runs a Gameboy with a rewind history and rewinds it all the way back.
+ *
+ * @param seed Seed of the Gameboy's ROM, memory and buttons.
+ * @param interval Frames between snapshots, divides REWIND_FRAMES.
+*/
+static void test_rewind(uint32_t seed, uint32_t interval) {
+    Gameboy* gb = test_create_gameboy(seed);
+    GameboyRewind* rewind = gameboy_rewind_create(gb, interval, 20);
+    size_t size = gameboy_state_size(gb);
+    uint8_t* states = malloc((REWIND_FRAMES + 1) * size);
+    uint8_t* state = malloc(size);
+    uint8_t buttons[REWIND_FRAMES];
+    uint32_t random = seed;
+
+    // The state before frame i is kept in states + i*size.
+    gameboy_rewind_frame(rewind, gb);
+    gameboy_save_state(gb, states);
+    for (uint32_t frame = 0; frame < REWIND_FRAMES; frame++) {
+        buttons[frame] = test_random(&random);
+        gameboy_single_frame_update(gb, buttons[frame], NULL);
+        gameboy_rewind_frame(rewind, gb);
+        gameboy_save_state(gb, states + (frame + 1)*size);
+    }
+
+    // A Gameboy that ran past the newest snapshot goes back to it.
+    gameboy_single_frame_update(gb, 0, NULL);
+    gameboy_single_frame_update(gb, 0, NULL);
+    CHECK(gameboy_rewind_step(rewind, gb) == 0);
+    gameboy_save_state(gb, state);
+    CHECK(memcmp(state, states + REWIND_FRAMES*size, size) == 0);
+
+    // Every step goes back one snapshot, to exactly the state saved then.
+    for (uint32_t frame = REWIND_FRAMES; frame >= interval; frame -= interval) {
+        CHECK(gameboy_rewind_step(rewind, gb) == 0);
+        gameboy_save_state(gb, state);
+        CHECK(memcmp(state, states + (frame - interval)*size, size) == 0);
+    }
+    CHECK(gameboy_rewind_step(rewind, gb) == 1);
+
+    // The rewound Gameboy runs the same frames again.
+    for (uint32_t frame = 0; frame < REWIND_FRAMES; frame++) {
+        gameboy_single_frame_update(gb, buttons[frame], NULL);
+        gameboy_save_state(gb, state);
+        CHECK(memcmp(state, states + (frame + 1)*size, size) == 0);
+    }
+
+    free(state);
+    free(states);
+    gameboy_rewind_destroy(rewind);
+    gameboy_destroy(gb);
+}
+
+/** Fills a rewind history too small for the run and checks only the oldest snapshots are lost.
+ *
+ * @param seed Seed of the Gameboy's ROM, memory and buttons.
+*/
+static void test_rewind_full(uint32_t seed) {
+    Gameboy* gb = test_create_gameboy(seed);
+    GameboyRewind* rewind = gameboy_rewind_create(gb, 1, 14);
+    size_t size = gameboy_state_size(gb);
+    uint8_t* states = malloc((REWIND_FRAMES + 1) * size);
+    uint8_t* state = malloc(size);
+    uint32_t random = seed;
+
+    gameboy_rewind_frame(rewind, gb);
+    gameboy_save_state(gb, states);
+    for (uint32_t frame = 0; frame < REWIND_FRAMES; frame++) {
+        gameboy_single_frame_update(gb, test_random(&random), NULL);
+        gameboy_rewind_frame(rewind, gb);
+        gameboy_save_state(gb, states + (frame + 1)*size);
+    }
+
+    uint32_t frame = REWIND_FRAMES;
+    while (gameboy_rewind_step(rewind, gb) == 0) {
+        CHECK(frame > 0);
+        frame--;
+        gameboy_save_state(gb, state);
+        CHECK(memcmp(state, states + frame*size, size) == 0);
+    }
+    CHECK(frame > 0 && frame < REWIND_FRAMES);
+
+    free(state);
+    free(states);
+    gameboy_rewind_destroy(rewind);
+    gameboy_destroy(gb);
+}
+
+int main(void) {
+    for (uint32_t seed = 1; seed <= REWIND_SEEDS; seed++) {
+        test_rewind(seed, 1);
+        test_rewind(seed, 4);
+        test_rewind_full(seed);
+    }
+    printf("test_rewind: passed\n");
+    return 0;
+}
@@ -0,0 +1,73 @@
+// Composites random lines of color numbers through the scalar and the SSSE3 compositor and
+// checks that both write the same bytes.
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "screen.h"
+#include "test_util.h"
+
+#define SCREEN_TEST_LINES 10000
+
+int main(void) {
+#ifdef SCREEN_SSSE3
+    if (!__builtin_cpu_supports("ssse3")) {
+        printf("test_screen: skipped, the cpu does not support SSSE3\n");
+        return 0;
+    }
+
+    const ScreenCompositor* scalar = &screen_compositor_scalar;
+    const ScreenCompositor* ssse3 = &screen_compositor_ssse3;
+    uint32_t state = 1;
+
+    for (uint32_t line = 0; line < SCREEN_TEST_LINES; line++) {
+        uint8_t colors[SCREEN_WIDTH];
+        uint8_t scalar_shades[SCREEN_WIDTH + 8];
+        uint8_t ssse3_shades[SCREEN_WIDTH + 8];
+        for (uint32_t x = 0; x < SCREEN_WIDTH; x++) colors[x] = test_random(&state) & 0x3;
+
+        uint8_t pallet = test_random(&state);
+        scalar->map_pallet(colors, pallet, scalar_shades);
+        ssse3->map_pallet(colors, pallet, ssse3_shades);
+        CHECK(memcmp(scalar_shades, ssse3_shades, SCREEN_WIDTH) == 0);
+
+        // Sprites at random positions with random palettes and priorities.
+        for (uint32_t sprite = 0; sprite < 10; sprite++) {
+            uint8_t x_pos = test_random(&state) % (SCREEN_WIDTH - 8 + 1);
+            uint8_t sprite_pallet = test_random(&state);
+            bool behind = test_random(&state) & 1;
+            uint8_t sprite_colors[8];
+            for (uint32_t col = 0; col < 8; col++) sprite_colors[col] = test_random(&state) & 0x3;
+
+            scalar->merge_sprite(scalar_shades + x_pos, sprite_colors, sprite_pallet, behind);
+            ssse3->merge_sprite(ssse3_shades + x_pos, sprite_colors, sprite_pallet, behind);
+            CHECK(memcmp(scalar_shades, ssse3_shades, SCREEN_WIDTH) == 0);
+        }
+
+        FrameOutput output;
+        for (uint32_t shade = 0; shade < 4; shade++) {
+            for (uint32_t i = 0; i < 4; i++) output.pixels[shade][i] = test_random(&state);
+        }
+
+        uint8_t scalar_pixels[SCREEN_WIDTH*3];
+        uint8_t ssse3_pixels[SCREEN_WIDTH*3];
+        output.format = FRAME_RGB888;
+        output.bytes_per_pixel = 3;
+        scalar->write_rgb888(scalar_shades, &output, scalar_pixels);
+        ssse3->write_rgb888(ssse3_shades, &output, ssse3_pixels);
+        CHECK(memcmp(scalar_pixels, ssse3_pixels, SCREEN_WIDTH*3) == 0);
+
+        output.format = FRAME_GRAY8;
+        output.bytes_per_pixel = 1;
+        scalar->write_gray8(scalar_shades, &output, scalar_pixels);
+        ssse3->write_gray8(ssse3_shades, &output, ssse3_pixels);
+        CHECK(memcmp(scalar_pixels, ssse3_pixels, SCREEN_WIDTH) == 0);
+    }
+
+    printf("test_screen: %u lines composited the same\n", SCREEN_TEST_LINES);
+#else
+    printf("test_screen: skipped, the SSSE3 compositor is not built\n");
+#endif
+    return 0;
+}
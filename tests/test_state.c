@@ -0,0 +1,207 @@
+// Saves, loads, snapshots and runs ahead, and checks that a Gameboy carries on exactly as it
+// would have from the state it was given.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+#include "gameboy_state.h"
+#include "memory.h"
+#include "test_util.h"
+
+/** Creates a Gameboy that waits for every V-Blank interrupt in an EI; HALT loop, so it is
+ *  halted at the end of every frame.
+ *
+ * @return A pointer to the Gameboy created.
+*/
+static Gameboy* state_create_halting_gameboy(void) {
+    static const uint8_t code[] = {
+        0xFB,               // EI
+        0x76,               // HALT
+        0x18, 0xFC,         // JR -4
+    };
+
+    uint8_t* rom = calloc(1, TEST_ROM_SIZE);
+    rom[0x40] = 0xD9;       // RETI
+    rom[0x100] = 0xC3;
+    rom[0x101] = TEST_CODE_START & 0xFF;
+    rom[0x102] = TEST_CODE_START >> 8;
+    rom[0x147] = 0x03;
+    rom[0x148] = 0x01;
+    rom[0x149] = 0x03;
+    for (uint32_t i = 0; i < sizeof(code); i++) rom[TEST_CODE_START + i] = code[i];
+
+    Gameboy* gb = gameboy_create();
+    test_load_rom(gb, rom, TEST_ROM_SIZE);
+    free(rom);
+    gameboy_skip_bootstrap(gb);
+    gb->memory[0xFFFF] = 0x01;
+    gameboy_invalidate_state_hash(gb);
+    return gb;
+}
+
+/** Loads a state saved while halted into a Gameboy that has run further, then checks the
+ *  next frame matches the frame run straight after saving.
+*/
+static void test_load_older_halted_state(void) {
+    Gameboy* gb = state_create_halting_gameboy();
+    size_t size = gameboy_state_size(gb);
+    uint8_t* older = malloc(size);
+    uint8_t* expected = malloc(size);
+    uint8_t* actual = malloc(size);
+
+    for (uint32_t frame = 0; frame < 3; frame++) gameboy_single_frame_update(gb, 0, NULL);
+    CHECK(gb->halted);
+    gameboy_save_state(gb, older);
+    gameboy_single_frame_update(gb, 0, NULL);
+    gameboy_save_state(gb, expected);
+
+    for (uint32_t frame = 0; frame < 5; frame++) gameboy_single_frame_update(gb, 0, NULL);
+    CHECK(gameboy_load_state(gb, older, size) == 0);
+    CHECK(gb->halted);
+    gameboy_single_frame_update(gb, 0, NULL);
+    gameboy_save_state(gb, actual);
+    CHECK(memcmp(expected, actual, size) == 0);
+
+    free(older);
+    free(expected);
+    free(actual);
+    gameboy_destroy(gb);
+}
+
+/** Runs ahead of a Gameboy every frame and checks it is left in the same state as a Gameboy
+ *  run normally, while the frame shown is the one a fork of it draws frames later.
+ *
+ * @param seed Seed of the Gameboy's ROM, memory and buttons.
+ * @param frames Number of frames to run ahead.
+*/
+static void test_run_ahead(uint32_t seed, uint32_t frames) {
+    static uint8_t frame_buffer[160*144*3];
+    static uint8_t expected_frame[160*144*3];
+    Gameboy* gb = test_create_gameboy(seed);
+    Gameboy* reference = test_create_gameboy(seed);
+    GameboySnapshot* snapshot = gameboy_snapshot_create(gb);
+    size_t size = gameboy_state_size(gb);
+    uint8_t* expected = malloc(size);
+    uint8_t* actual = malloc(size);
+    uint32_t random = seed;
+    uint8_t drawn = 0;
+
+    for (uint32_t frame = 0; frame < 20; frame++) {
+        uint8_t buttons = test_random(&random);
+        memset(frame_buffer, 0, sizeof(frame_buffer));
+        memset(expected_frame, 0, sizeof(expected_frame));
+
+        // The random code soon turns the LCD off, turn it back on so there is a frame to check.
+        memory_set8(gb, 0xFF40, 0x91);
+        memory_set8(reference, 0xFF40, 0x91);
+
+        gameboy_run_ahead(gb, snapshot, buttons, frames, frame_buffer);
+        gameboy_single_frame_update(reference, buttons, frames ? NULL : expected_frame);
+        Gameboy* ahead = gameboy_fork(reference);
+        for (uint32_t i = 1; i <= frames; i++) {
+            gameboy_single_frame_update(ahead, buttons, i == frames ? expected_frame : NULL);
+        }
+        gameboy_destroy(ahead);
+
+        gameboy_save_state(gb, actual);
+        gameboy_save_state(reference, expected);
+        CHECK(memcmp(expected, actual, size) == 0);
+        CHECK(memcmp(expected_frame, frame_buffer, sizeof(frame_buffer)) == 0);
+        for (uint32_t i = 0; i < sizeof(frame_buffer); i++) drawn |= frame_buffer[i];
+    }
+    CHECK(drawn);
+
+    free(expected);
+    free(actual);
+    gameboy_snapshot_destroy(snapshot);
+    gameboy_destroy(reference);
+    gameboy_destroy(gb);
+}
+
+/** Gets the hash of a Gameboy's state with every page hashed again.
+ *
+ * @param gb Gameboy to operate on.
+ * @return The hash.
+*/
+static uint64_t state_full_hash(Gameboy* gb) {
+    gameboy_invalidate_state_hash(gb);
+    return gameboy_state_hash(gb);
+}
+
+/** Checks the incremental state hash matches a full one every frame, changes with any write
+ *  and with any state kept outside memory, and is the same for a Gameboy loaded from a state.
+ *
+ * @param seed Seed of the Gameboy's ROM, memory and buttons.
+*/
+static void test_state_hash(uint32_t seed) {
+    Gameboy* gb = test_create_gameboy(seed);
+    size_t size = gameboy_state_size(gb);
+    uint8_t* state = malloc(size);
+    uint32_t random = seed;
+
+    for (uint32_t frame = 0; frame < 20; frame++) {
+        gameboy_single_frame_update(gb, test_random(&random), NULL);
+        uint64_t hash = gameboy_state_hash(gb);
+        CHECK(hash == state_full_hash(gb));
+
+        // A write to a page that was just hashed is seen without invalidating the hash, in a
+        // Gameboy and in a fork still sharing the page.
+        Gameboy* child = gameboy_fork(gb);
+        CHECK(gameboy_state_hash(child) == hash);
+        uint16_t address = 0xC000 + test_random(&random) % 0x2000;
+        uint8_t value = memory_get8(gb, address);
+        memory_set8(child, address, value ^ 0x01);
+        CHECK(gameboy_state_hash(child) != hash);
+        CHECK(gameboy_state_hash(child) == state_full_hash(child));
+        gameboy_destroy(child);
+        CHECK(gameboy_state_hash(gb) == hash);
+
+        memory_set8(gb, address, value ^ 0x01);
+        CHECK(gameboy_state_hash(gb) != hash);
+        memory_set8(gb, address, value);
+        CHECK(gameboy_state_hash(gb) == hash);
+    }
+
+    // State kept outside memory changes the hash.
+    uint64_t hash = gameboy_state_hash(gb);
+    gb->int_master_enable ^= 1;
+    CHECK(gameboy_state_hash(gb) != hash);
+    gb->int_master_enable ^= 1;
+    gb->halted ^= 1;
+    CHECK(gameboy_state_hash(gb) != hash);
+    gb->halted ^= 1;
+    gb->current_ram_bank ^= 1;
+    CHECK(gameboy_state_hash(gb) != hash);
+    gb->current_ram_bank ^= 1;
+    gb->rtc.registers[0] ^= 1;
+    CHECK(gameboy_state_hash(gb) != hash);
+    gb->rtc.registers[0] ^= 1;
+    gb->scheduler.deadlines[EVENT_SCANLINE]++;
+    CHECK(gameboy_state_hash(gb) != hash);
+    gb->scheduler.deadlines[EVENT_SCANLINE]--;
+    CHECK(gameboy_state_hash(gb) == hash);
+
+    // A Gameboy loaded from a saved state has the same hash.
+    Gameboy* loaded = test_create_gameboy(seed);
+    gameboy_save_state(gb, state);
+    CHECK(gameboy_load_state(loaded, state, size) == 0);
+    CHECK(gameboy_state_hash(loaded) == hash);
+
+    free(state);
+    gameboy_destroy(loaded);
+    gameboy_destroy(gb);
+}
+
+int main(void) {
+    test_load_older_halted_state();
+    for (uint32_t seed = 1; seed <= 4; seed++) test_state_hash(seed);
+    for (uint32_t seed = 1; seed <= 4; seed++) {
+        test_run_ahead(seed, 0);
+        test_run_ahead(seed, 1);
+        test_run_ahead(seed, 3);
+    }
+    printf("test_state: passed\n");
+    return 0;
+}
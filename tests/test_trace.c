@@ -0,0 +1,86 @@
+#define _POSIX_C_SOURCE 200809L
+
+// Pushes records into a small trace buffer while a second thread drains it, so the ring wraps
+// many times, and checks every record written out is intact, in order, and that the records
+// written and dropped add up to the records pushed.
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test_util.h"
+#include "trace.h"
+
+#define TRACE_TEST_RECORDS 2000000
+#define TRACE_TEST_CAPACITY_LOG2 6
+
+/** Ring buffer and file shared with the draining thread. */
+typedef struct trace_test_t {
+    TraceBuffer* trace;
+    FILE* fp;
+    atomic_int done;            // Set once every record has been pushed.
+    uint64_t written;
+} TraceTest;
+
+/** Makes the record with an index, every field derived from it so torn records are found.
+ *
+ * @param index Index of the record.
+ * @return The record.
+*/
+static TraceRecord trace_test_record(uint64_t index) {
+    TraceRecord record;
+    record.cycle = index;
+    record.pc = index * 7;
+    record.bank = index >> 16;
+    record.opcode = index * 3;
+    record.operands[0] = index >> 8;
+    record.operands[1] = ~index;
+    record.padding = 0;
+    return record;
+}
+
+static void* trace_test_drain(void* arg) {
+    TraceTest* test = arg;
+    while (!atomic_load(&test->done)) test->written += trace_drain(test->trace, test->fp);
+    test->written += trace_drain(test->trace, test->fp);
+    return NULL;
+}
+
+int main(void) {
+    TraceTest test = {trace_create(TRACE_TEST_CAPACITY_LOG2), tmpfile(), 0, 0};
+    CHECK(test.fp != NULL);
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, trace_test_drain, &test) == 0);
+    for (uint64_t i = 0; i < TRACE_TEST_RECORDS; i++) {
+        TraceRecord record = trace_test_record(i);
+        trace_push(test.trace, &record);
+    }
+    atomic_store(&test.done, 1);
+    pthread_join(thread, NULL);
+
+    CHECK(test.written + test.trace->dropped == TRACE_TEST_RECORDS);
+    CHECK(test.written > 0);
+
+    rewind(test.fp);
+    TraceRecord record;
+    uint64_t read = 0;
+    int64_t last = -1;
+    while (fread(&record, sizeof(TraceRecord), 1, test.fp) == 1) {
+        TraceRecord expected = trace_test_record(record.cycle);
+        CHECK(record.cycle < TRACE_TEST_RECORDS && (int64_t) record.cycle > last);
+        CHECK(record.pc == expected.pc && record.bank == expected.bank);
+        CHECK(record.opcode == expected.opcode && record.operands[0] == expected.operands[0] &&
+              record.operands[1] == expected.operands[1] && record.padding == 0);
+        last = record.cycle;
+        read++;
+    }
+    CHECK(read == test.written);
+
+    printf("test_trace: %llu records written, %llu dropped\n", (unsigned long long) test.written,
+           (unsigned long long) test.trace->dropped);
+    fclose(test.fp);
+    trace_destroy(test.trace);
+    return 0;
+}
@@ -0,0 +1,166 @@
+#ifndef TESTS_TEST_UTIL_H_
+#define TESTS_TEST_UTIL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+#include "disassembler.h"
+#include "gameboy.h"
+
+#define TEST_ROM_SIZE 0x10000   // 4 banks, the size code 0x01 in the header.
+#define TEST_CODE_START 0x0150  // First instruction of test_create_rom's code.
+#define TEST_CODE_END 0x7FF8    // Jump back to TEST_CODE_START at the end of every bank.
+
+// Fails the test with the location of the check if the condition does not hold.
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(1); \
+        } \
+    } while (0)
+
+/** Gets the next number of a xorshift generator, so tests are the same on every run.
+ *
+ * @param state State of the generator, must not be 0.
+ * @return The number.
+*/
+static inline uint32_t test_random(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/** Gets a random address of an instruction in test_create_rom's code.
+ *
+ * @param state State of the generator.
+ * @return The address.
+*/
+static inline uint16_t test_random_target(uint32_t* state) {
+    return TEST_CODE_START + 3*(test_random(state) % ((TEST_CODE_END - TEST_CODE_START) / 3));
+}
+
+/** Writes a random instruction, padded with NOPs to 3 bytes.
+ *
+ * @param state State of the generator.
+ * @param code Where to write the instruction.
+ * @param address Address the instruction is run from.
+*/
+static inline void test_random_instruction(uint32_t* state, uint8_t* code, uint16_t address) {
+    uint8_t opcode;
+    do {
+        opcode = test_random(state);
+    } while (instruction_lengths[opcode] == 0 || opcode == 0xE9 ||
+             opcode == 0xC0 || opcode == 0xC8 || opcode == 0xC9 ||
+             opcode == 0xD0 || opcode == 0xD8 || opcode == 0xD9);
+
+    code[0] = opcode;
+    code[1] = instruction_lengths[opcode] > 1 ? test_random(state) : 0x00;
+    code[2] = instruction_lengths[opcode] > 2 ? test_random(state) : 0x00;
+
+    switch (opcode) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: {
+            // JR, to the start of another instruction.
+            int32_t offset = 1 + 3*((int32_t) (test_random(state) % 86) - 43);
+            int32_t target = address + 2 + offset;
+            if (target < TEST_CODE_START || target >= TEST_CODE_END || offset == -2) offset = 1;
+            code[1] = (uint8_t) offset;
+            break;
+        }
+        case 0xC2: case 0xC3: case 0xC4: case 0xCA: case 0xCC: case 0xCD:
+        case 0xD2: case 0xD4: case 0xDA: case 0xDC: {
+            uint16_t target = test_random_target(state);
+            code[1] = target & 0xFF;
+            code[2] = target >> 8;
+            break;
+        }
+    }
+}
+
+/** Creates a MBC1 cartridge ROM of random instructions.
+ *
+ *  Every instruction is padded to 3 bytes and starts at an address that is a multiple of 3,
+ *  whichever bank is mapped. Jumps, calls and interrupts only go to those addresses and the
+ *  instructions that return or jump to an address read from registers or the stack are left
+ *  out, so the cpu only ever executes the generated code however it changes memory.
+ *
+ * @param seed Seed of the random contents, not 0.
+ * @return The cartridge ROM, TEST_ROM_SIZE bytes.
+*/
+static inline uint8_t* test_create_rom(uint32_t seed) {
+    uint32_t state = seed;
+    uint8_t* rom = calloc(1, TEST_ROM_SIZE);
+
+    // Restart and interrupt vectors. Interrupts are enabled again straight away, so they can
+    // break the cpu out of any loop.
+    for (uint16_t vector = 0x00; vector <= 0x60; vector += 0x08) {
+        uint16_t target = test_random_target(&state);
+        rom[vector] = 0xFB;
+        rom[vector+1] = 0xC3;
+        rom[vector+2] = target & 0xFF;
+        rom[vector+3] = target >> 8;
+    }
+    rom[0x100] = 0xC3;
+    rom[0x101] = TEST_CODE_START & 0xFF;
+    rom[0x102] = TEST_CODE_START >> 8;
+    rom[0x147] = 0x03;  // MBC1+RAM+BATTERY
+    rom[0x148] = 0x01;  // 4 ROM banks
+    rom[0x149] = 0x03;  // 4 RAM banks
+
+    // Bank 0 ends with a NOP at 0x3FFF that runs on into two NOPs at the start of every bank.
+    for (uint32_t address = TEST_CODE_START; address + 3 <= 0x3FFF; address += 3) {
+        test_random_instruction(&state, rom + address, address);
+    }
+    for (uint32_t bank = 1; bank < TEST_ROM_SIZE / 0x4000; bank++) {
+        uint8_t* code = rom + bank*0x4000 - 0x4000;
+        for (uint32_t address = 0x4002; address < TEST_CODE_END; address += 3) {
+            test_random_instruction(&state, code + address, address);
+        }
+        code[TEST_CODE_END] = 0xC3;
+        code[TEST_CODE_END+1] = TEST_CODE_START & 0xFF;
+        code[TEST_CODE_END+2] = TEST_CODE_START >> 8;
+    }
+    return rom;
+}
+
+/** Loads a cartridge ROM from a buffer through a temporary file.
+ *
+ * @param gb Gameboy to operate on.
+ * @param rom Cartridge ROM.
+ * @param size Size of the cartridge ROM in bytes.
+*/
+static inline void test_load_rom(Gameboy* gb, const uint8_t* rom, uint32_t size) {
+    FILE* fp = tmpfile();
+    CHECK(fp != NULL);
+    fwrite(rom, 1, size, fp);
+    rewind(fp);
+    gameboy_load_rom(gb, fp);
+    fclose(fp);
+}
+
+/** Creates a Gameboy running test_create_rom's cartridge, with random work RAM and high RAM
+ *  and the LCD and every interrupt enabled, so every part of the state changes as it runs.
+ *
+ * @param seed Seed of the random contents, not 0.
+ * @return A pointer to the Gameboy created.
+*/
+static inline Gameboy* test_create_gameboy(uint32_t seed) {
+    uint32_t state = seed;
+    uint8_t* rom = test_create_rom(seed);
+    Gameboy* gb = gameboy_create();
+    test_load_rom(gb, rom, TEST_ROM_SIZE);
+    free(rom);
+    gameboy_skip_bootstrap(gb);
+
+    for (uint32_t i = 0xC000; i < 0xE000; i++) gb->memory[i] = test_random(&state);
+    for (uint32_t i = 0xFF80; i < 0xFFFF; i++) gb->memory[i] = test_random(&state);
+    gb->memory[0xFFFF] = 0x1F;
+    gb->int_master_enable = 1;
+    gameboy_invalidate_state_hash(gb);
+    return gb;
+}
+
+#endif  // TESTS_TEST_UTIL_H_